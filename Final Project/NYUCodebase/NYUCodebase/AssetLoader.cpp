@@ -0,0 +1,52 @@
+
+#include "AssetLoader.h"
+#include <SDL.h>
+
+AssetLoader::AssetLoader() : nextJob(0), finishedJobs(0) {}
+
+AssetLoader::~AssetLoader() {
+	Wait();
+}
+
+void AssetLoader::Add(LoadFunction load, int argument) {
+	Job job;
+	job.load = load;
+	job.argument = argument;
+	jobs.push_back(job);
+}
+
+void AssetLoader::Start(unsigned int threads) {
+	nextJob = 0;
+	finishedJobs = 0;
+	if (threads == 0) {
+		Work();
+		return;
+	}
+	for (unsigned int i = 0; i < threads && i < jobs.size(); i++) {
+		workers.push_back(std::thread(&AssetLoader::Work, this));
+	}
+}
+
+// every worker takes the next job nobody has started, so slow files do not hold up the rest
+void AssetLoader::Work() {
+	for (unsigned int job = nextJob++; job < jobs.size(); job = nextJob++) {
+		jobs[job].load(jobs[job].argument);
+		if (++finishedJobs == jobs.size()) {
+			SDL_Event event;
+			SDL_memset(&event, 0, sizeof(event));
+			event.type = SDL_USEREVENT;
+			SDL_PushEvent(&event);
+		}
+	}
+}
+
+bool AssetLoader::Finished() const {
+	return finishedJobs == jobs.size();
+}
+
+void AssetLoader::Wait() {
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+	workers.clear();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+// runs file decoding jobs on a few threads while the main thread keeps the GL context
+// jobs must not touch GL or anything the main thread is using until Wait has returned
+class AssetLoader {
+	public:
+		typedef void (*LoadFunction)(int argument);
+
+		AssetLoader();
+		~AssetLoader();
+
+		// argument is handed back to load, usually an index into the caller's own asset table
+		void Add(LoadFunction load, int argument);
+		// with 0 threads the jobs run on the calling thread before Start returns
+		void Start(unsigned int threads);
+		// true once every job has run, the last one also pushes an SDL_USEREVENT to wake the main loop
+		bool Finished() const;
+		void Wait();
+
+	private:
+		struct Job {
+			LoadFunction load;
+			int argument;
+		};
+
+		void Work();
+
+		std::vector<Job> jobs;
+		std::vector<std::thread> workers;
+		std::atomic<unsigned int> nextJob;
+		std::atomic<unsigned int> finishedJobs;
+};
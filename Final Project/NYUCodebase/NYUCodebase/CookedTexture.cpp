@@ -0,0 +1,61 @@
+
+#include "CookedTexture.h"
+#include "stb_image.h"
+#include <stdio.h>
+
+std::string cookedTextureName(const std::string &imageFile) {
+	size_t extension = imageFile.find_last_of('.');
+	return imageFile.substr(0, extension) + ".rgba";
+}
+
+bool cookTexture(const std::string &imageFile) {
+	CookedTextureHeader header;
+	unsigned char *pixels = stbi_load(imageFile.c_str(), &header.width, &header.height, NULL, STBI_rgb_alpha);
+	if (pixels == NULL) {
+		return false;
+	}
+	header.magic = COOKED_TEXTURE_MAGIC;
+	header.version = COOKED_TEXTURE_VERSION;
+
+	FILE *file = fopen(cookedTextureName(imageFile).c_str(), "wb");
+	if (file == NULL) {
+		stbi_image_free(pixels);
+		return false;
+	}
+	size_t pixelBytes = (size_t)header.width * header.height * 4;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(pixels, 1, pixelBytes, file) == pixelBytes;
+	stbi_image_free(pixels);
+	return fclose(file) == 0 && written;
+}
+
+CookedTexture::CookedTexture() : pixels(NULL), width(0), height(0) {}
+
+bool CookedTexture::Open(const std::string &imageFile) {
+	Close();
+	std::string cookedFile = cookedTextureName(imageFile);
+	if (!fileIsCurrent(cookedFile, imageFile) || !file.Open(cookedFile) || file.size < sizeof(CookedTextureHeader)) {
+		Close();
+		return false;
+	}
+
+	const CookedTextureHeader *header = (const CookedTextureHeader*)file.data;
+	bool valid = header->magic == COOKED_TEXTURE_MAGIC && header->version == COOKED_TEXTURE_VERSION
+		&& header->width > 0 && header->height > 0
+		&& sizeof(CookedTextureHeader) + (uint64_t)header->width * header->height * 4 == file.size;
+	if (!valid) {
+		Close();
+		return false;
+	}
+
+	width = header->width;
+	height = header->height;
+	pixels = (unsigned char*)file.data + sizeof(CookedTextureHeader);
+	return true;
+}
+
+void CookedTexture::Close() {
+	file.Close();
+	pixels = NULL;
+	width = 0;
+	height = 0;
+}
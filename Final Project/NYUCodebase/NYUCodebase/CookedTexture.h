@@ -0,0 +1,40 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <stdint.h>
+#include <string>
+
+// "TEXR" when read as bytes
+#define COOKED_TEXTURE_MAGIC 0x52584554
+#define COOKED_TEXTURE_VERSION 1
+
+// an image already decoded to the RGBA8 rows glTexImage2D takes, so loading it is only a mapping
+// the header is followed by width * height * 4 bytes of pixels, top row first like stb_image
+struct CookedTextureHeader {
+	uint32_t magic;
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+};
+
+// font1.png cooks to font1.rgba
+std::string cookedTextureName(const std::string &imageFile);
+// decodes imageFile and writes its cooked file next to it
+bool cookTexture(const std::string &imageFile);
+
+// the mapped pixels of a cooked texture, they stay valid until Close
+class CookedTexture {
+	public:
+		CookedTexture();
+
+		// false when there is no cooked file for imageFile, it is older than the image or it is damaged
+		bool Open(const std::string &imageFile);
+		void Close();
+
+		unsigned char *pixels;
+		int width;
+		int height;
+
+	private:
+		MappedFile file;
+};
@@ -0,0 +1,2409 @@
+#include "Game.h"
+#include "LevelFile.h"
+#include "MapTokenizer.h"
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+// for parsing map
+#include <string>
+#include <sstream>
+#include <iostream>
+
+// for AI
+#include <utility> // for pair
+#include <tuple>
+#include <algorithm> // for fill and the open list heap
+#include <climits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifdef _MSC_VER
+#include <intrin.h> // for the bit scans
+#endif
+using namespace std;
+
+GameState state;
+PathMode pathMode = PATH_FLOW_FIELD;
+GameEvents gameEvents;
+
+// the same seed, level and inputs always play out the same way
+uint32_t gameSeed = 0;
+uint32_t levelSeed;
+uint32_t turnNumber; // enemy turns since the level was loaded
+
+int mapWidth;
+int mapHeight;
+short **levelData;
+EntityType **entityPositionData; // for movement checks
+
+unsigned int playerSpriteSheet;
+unsigned int skullSpriteSheet;
+unsigned int torchSpriteSheet;
+unsigned int sideTorchSpriteSheet;
+unsigned int keySpriteSheet;
+unsigned int mapSpriteSheet;
+unsigned int swordSprite;
+string gameOverMessage = "";
+
+int currentLevel = 1;
+int keyCount = 0;
+
+const char *pathModeNames[] = { "astar", "jps", "flow", "incremental", "hierarchical" };
+
+bool pathModeFromName(const string& name, PathMode& mode) {
+	for (int i = 0; i < (int)(sizeof(pathModeNames) / sizeof(pathModeNames[0])); i++) {
+		if (name == pathModeNames[i]) {
+			mode = (PathMode)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void worldToTileCoordinates(float worldX, float worldY, int& gridX, int& gridY) {
+	gridX = (int)(worldX / MAP_TILE_SIZE);
+	gridY = (int)(worldY / -MAP_TILE_SIZE);
+}
+
+bool isSolid(int tileIndex) {
+	// the walls
+	return ((tileIndex >= 0 && tileIndex <= 5)
+		|| tileIndex == 10 || tileIndex == 15
+		|| tileIndex == 10 || tileIndex == 15
+		|| tileIndex == 20 || tileIndex == 25
+		|| tileIndex == 30 || tileIndex == 35
+		|| (tileIndex >= 40 && tileIndex <= 45)
+		|| (tileIndex >= 50 && tileIndex <= 55));
+}
+
+int lowestBit(uint32_t word) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, word);
+	return (int)index;
+#else
+	return __builtin_ctz(word);
+#endif
+}
+
+int highestBit(uint32_t word) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, word);
+	return (int)index;
+#else
+	return 31 - __builtin_clz(word);
+#endif
+}
+
+// Philox 2x32-10 counter based random numbers, the result only depends on the arguments
+// so any thread can draw the number of any skull for any turn without shared state
+uint32_t philox(uint32_t counterHigh, uint32_t counterLow, uint32_t key) {
+	for (int round = 0; round < 10; round++) {
+		uint64_t product = (uint64_t)0xD256D193u * counterLow;
+		uint32_t high = (uint32_t)(product >> 32) ^ counterHigh ^ key;
+		counterLow = high;
+		counterHigh = (uint32_t)product;
+		key += 0x9E3779B9u;
+	}
+	return counterLow;
+}
+
+// one bit per tile, built when the level loads and kept up to date through tileChanged()
+// open tiles can be stepped on (no wall, door or skull), terrain tiles only ignore skulls
+// rows have a blocked border of one tile all around, so neighbours never need bounds checks
+class PassabilityGrid {
+public:
+	// the bits Update gives once the entities of the level are placed, the last entity on a
+	// tile wins there as it does in entityPositionData
+	void Build(const LoadedLevel& level) {
+		width = level.width;
+		height = level.height;
+		wordsPerRow = (width + 2 + 31) / 32;
+		open.assign(wordsPerRow * (height + 2), 0);
+		terrain.assign(wordsPerRow * (height + 2), 0);
+		const short *tiles = level.Tiles();
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				bool walkable = !isSolid(tiles[y * width + x]);
+				SetBit(terrain, x, y, walkable);
+				SetBit(open, x, y, walkable);
+			}
+		}
+		for (const LevelFileEntity& entity : level.entities) {
+			if (entity.type == ENTITY_PLAYER || entity.type == ENTITY_SKULL || entity.type == ENTITY_DOOR) {
+				// entity rows are one lower than the layer
+				int tileY = entity.y - 1;
+				bool walkable = !isSolid(tiles[tileY * width + entity.x]) && entity.type != ENTITY_DOOR;
+				SetBit(terrain, entity.x, tileY, walkable);
+				SetBit(open, entity.x, tileY, walkable && entity.type != ENTITY_SKULL);
+			}
+		}
+	}
+
+	void Update(int tileX, int tileY) {
+		bool walkable = !isSolid(levelData[tileY][tileX]) && entityPositionData[tileY][tileX] != ENTITY_DOOR;
+		SetBit(terrain, tileX, tileY, walkable);
+		SetBit(open, tileX, tileY, walkable && entityPositionData[tileY][tileX] != ENTITY_SKULL);
+	}
+
+	// valid from -1 to width and -1 to height
+	bool Open(int tileX, int tileY) const {
+		return GetBit(open, tileX, tileY);
+	}
+
+	bool Terrain(int tileX, int tileY) const {
+		return GetBit(terrain, tileX, tileY);
+	}
+
+	// packed open bits of a row, bit (tileX + 1) of the row belongs to tileX
+	const uint32_t* OpenRow(int tileY) const {
+		return &open[(tileY + 1) * wordsPerRow];
+	}
+
+	int wordsPerRow = 0;
+
+private:
+	void SetBit(vector<uint32_t>& bits, int tileX, int tileY, bool value) {
+		int column = tileX + 1;
+		uint32_t& word = bits[(tileY + 1) * wordsPerRow + column / 32];
+		if (value) {
+			word |= (1u << (column % 32));
+		}
+		else {
+			word &= ~(1u << (column % 32));
+		}
+	}
+
+	bool GetBit(const vector<uint32_t>& bits, int tileX, int tileY) const {
+		int column = tileX + 1;
+		return (bits[(tileY + 1) * wordsPerRow + column / 32] >> (column % 32)) & 1;
+	}
+
+	int width = 0;
+	int height = 0;
+	vector<uint32_t> open;
+	vector<uint32_t> terrain;
+};
+
+PassabilityGrid passability;
+
+int distance(int tileX, int tileY, int goalX, int goalY) {
+	return abs(tileX - goalX) + abs(tileY - goalY);
+}
+
+// an entry in the open list, index is tileY * mapWidth + tileX
+struct OpenNode {
+	int index;
+	int cost;
+	int priority;
+};
+
+struct OpenNodeCompare {
+	bool operator()(const OpenNode& first, const OpenNode& second) const {
+		return first.priority > second.priority;
+	}
+};
+
+// what one HierarchicalPlanner query needs, kept in the search context so queries can run
+// on every enemy thread at once
+struct HierarchyScratch {
+	vector<int> clusterDistance;
+	vector<int> clusterQueue;
+	vector<pair<int, int>> goalLinks;
+	vector<int> abstractCost;
+	vector<int> abstractParent;
+	vector<OpenNode> openList;
+};
+
+// reusable storage for aStarSearch, allocated once per level in setupScene
+// cost and parent of a tile are only valid while its stamp matches the current generation,
+// so starting a new search never has to clear the arrays
+class SearchContext {
+public:
+	void Resize(int width, int height) {
+		this->width = width;
+		this->height = height;
+		cost.assign(width * height, INT_MAX);
+		parent.assign(width * height, -1);
+		stamp.assign(width * height, 0);
+		generation = 0;
+
+		// every tile can be pushed at most once per neighbour
+		openList.clear();
+		openList.reserve(width * height * 4);
+	}
+
+	void Begin() {
+		generation++;
+		if (generation == 0) {
+			// stamps wrapped around, old values could look current again
+			fill(stamp.begin(), stamp.end(), 0);
+			generation = 1;
+		}
+		openList.clear();
+		nodesExpanded = 0;
+	}
+
+	int Cost(int index) const {
+		return stamp[index] == generation ? cost[index] : INT_MAX;
+	}
+
+	int Parent(int index) const {
+		return stamp[index] == generation ? parent[index] : -1;
+	}
+
+	void Set(int index, int newCost, int newParent) {
+		stamp[index] = generation;
+		cost[index] = newCost;
+		parent[index] = newParent;
+	}
+
+	void Push(int index, int newCost, int priority) {
+		OpenNode node = { index, newCost, priority };
+		openList.push_back(node);
+		push_heap(openList.begin(), openList.end(), OpenNodeCompare());
+	}
+
+	OpenNode Pop() {
+		pop_heap(openList.begin(), openList.end(), OpenNodeCompare());
+		OpenNode node = openList.back();
+		openList.pop_back();
+		return node;
+	}
+
+	bool Empty() const {
+		return openList.empty();
+	}
+
+	int width = 0;
+	int height = 0;
+	HierarchyScratch hierarchy;
+
+	// nodes taken off the open list by the last search, and since the level was loaded
+	int nodesExpanded = 0;
+	long long totalNodesExpanded = 0;
+
+private:
+	vector<int> cost;
+	vector<int> parent;
+	vector<unsigned> stamp;
+	unsigned generation = 0;
+	vector<OpenNode> openList;
+};
+
+SearchContext searchContext;
+
+void relaxNeighbour(SearchContext& context, int current, int currentCost, int tileX, int tileY, int goalX, int goalY) {
+	if (!passability.Open(tileX, tileY)) {
+		return;
+	}
+	int index = tileY * context.width + tileX;
+	if (currentCost + 1 < context.Cost(index)) {
+		context.Set(index, currentCost + 1, current);
+		context.Push(index, currentCost + 1, currentCost + 1 + distance(tileX, tileY, goalX, goalY));
+	}
+}
+
+// the step from one tile to the next one, which has to be a neighbour
+Direction directionTo(int tileX, int tileY, int nextX, int nextY) {
+	if (nextX > tileX) {
+		return DIRECTION_RIGHT;
+	}
+	else if (nextX < tileX) {
+		return DIRECTION_LEFT;
+	}
+	else if (nextY < tileY) {
+		return DIRECTION_UP;
+	}
+	else if (nextY > tileY) {
+		return DIRECTION_DOWN;
+	}
+	return DIRECTION_NONE;
+}
+
+// runs A* until the goal or limit expanded tiles, the parents in context lead back from the
+// returned tile, which is the goal when it was reached and otherwise the last tile expanded
+int aStarExpand(SearchContext& context, int tileX, int tileY, int goalX, int goalY, int limit) {
+	context.Begin();
+
+	int start = tileY * context.width + tileX;
+	context.Set(start, 0, -1);
+	context.Push(start, 0, distance(tileX, tileY, goalX, goalY));
+	int current = -1;
+
+	while (!context.Empty() && context.nodesExpanded < limit) {
+		OpenNode node = context.Pop();
+		if (node.cost > context.Cost(node.index)) {
+			// a cheaper way to this tile was already expanded
+			continue;
+		}
+		current = node.index;
+		context.nodesExpanded++;
+
+		int currentX = current % context.width;
+		int currentY = current / context.width;
+		if (currentX == goalX && currentY == goalY) {
+			break;
+		}
+
+		// check each direction
+		relaxNeighbour(context, current, node.cost, currentX, currentY + 1, goalX, goalY);
+		relaxNeighbour(context, current, node.cost, currentX, currentY - 1, goalX, goalY);
+		relaxNeighbour(context, current, node.cost, currentX + 1, currentY, goalX, goalY);
+		relaxNeighbour(context, current, node.cost, currentX - 1, currentY, goalX, goalY);
+	}
+	context.totalNodesExpanded += context.nodesExpanded;
+	return current;
+}
+
+// the first step of the way aStarExpand found from the tile to current
+Direction firstStep(const SearchContext& context, int tileX, int tileY, int current) {
+	int start = tileY * context.width + tileX;
+	if (current < 0 || current == start) {
+		return DIRECTION_NONE;
+	}
+
+	// walk back until the tile right next to the start
+	while (context.Parent(current) != start) {
+		current = context.Parent(current);
+	}
+	return directionTo(tileX, tileY, current % context.width, current / context.width);
+}
+
+Direction aStarSearch(SearchContext& context, int tileX, int tileY, int goalX, int goalY) {
+	return firstStep(context, tileX, tileY, aStarExpand(context, tileX, tileY, goalX, goalY, INT_MAX));
+}
+
+// jump point search for the 4-connected grid, shares the arena with aStarSearch
+// only tiles where the path could have to turn are pushed, long straight runs are skipped
+bool jumpWalkable(int tileX, int tileY) {
+	return passability.Open(tileX, tileY);
+}
+
+// returns the next jump point going left or right, or -1 if the run ends in a wall
+// the row is scanned 32 tiles at a time out of the passability bits, a run stops at the
+// first blocked tile, the goal, or where the row above or below opens up behind us
+int jumpHorizontal(int tileX, int tileY, int dx, int goalX, int goalY) {
+	const uint32_t* row = passability.OpenRow(tileY);
+	const uint32_t* above = passability.OpenRow(tileY - 1);
+	const uint32_t* below = passability.OpenRow(tileY + 1);
+	int words = passability.wordsPerRow;
+	int goalColumn = (goalY == tileY) ? goalX + 1 : -1;
+
+	if (dx > 0) {
+		int column = tileX + 2;
+		for (int word = column / 32; word < words; word++) {
+			// bit n of behindAbove is the tile left of bit n in the row above
+			uint32_t behindAbove = (above[word] << 1) | (word > 0 ? above[word - 1] >> 31 : 0);
+			uint32_t behindBelow = (below[word] << 1) | (word > 0 ? below[word - 1] >> 31 : 0);
+			uint32_t stops = ~row[word] | (above[word] & ~behindAbove) | (below[word] & ~behindBelow);
+			if (goalColumn >= 0 && goalColumn / 32 == word) {
+				stops |= 1u << (goalColumn % 32);
+			}
+			if (word == column / 32) {
+				stops &= ~0u << (column % 32);
+			}
+			if (stops) {
+				int stop = word * 32 + lowestBit(stops);
+				if (!((row[stop / 32] >> (stop % 32)) & 1)) {
+					return -1;
+				}
+				return tileY * mapWidth + stop - 1;
+			}
+		}
+	}
+	else {
+		int column = tileX;
+		for (int word = column / 32; word >= 0; word--) {
+			// bit n of behindAbove is the tile right of bit n in the row above
+			uint32_t behindAbove = (above[word] >> 1) | (word + 1 < words ? above[word + 1] << 31 : 0);
+			uint32_t behindBelow = (below[word] >> 1) | (word + 1 < words ? below[word + 1] << 31 : 0);
+			uint32_t stops = ~row[word] | (above[word] & ~behindAbove) | (below[word] & ~behindBelow);
+			if (goalColumn >= 0 && goalColumn / 32 == word) {
+				stops |= 1u << (goalColumn % 32);
+			}
+			if (word == column / 32 && column % 32 != 31) {
+				stops &= (1u << (column % 32 + 1)) - 1;
+			}
+			if (stops) {
+				int stop = word * 32 + highestBit(stops);
+				if (!((row[stop / 32] >> (stop % 32)) & 1)) {
+					return -1;
+				}
+				return tileY * mapWidth + stop - 1;
+			}
+		}
+	}
+	return -1;
+}
+
+// returns the next jump point going up or down, or -1 if the run ends in a wall
+int jumpVertical(int tileX, int tileY, int dy, int goalX, int goalY) {
+	while (true) {
+		tileY += dy;
+		if (!jumpWalkable(tileX, tileY)) {
+			return -1;
+		}
+		if (tileX == goalX && tileY == goalY) {
+			return tileY * mapWidth + tileX;
+		}
+		if ((jumpWalkable(tileX - 1, tileY) && !jumpWalkable(tileX - 1, tileY - dy))
+			|| (jumpWalkable(tileX + 1, tileY) && !jumpWalkable(tileX + 1, tileY - dy))) {
+			return tileY * mapWidth + tileX;
+		}
+		// vertical runs stop wherever a horizontal run would find something
+		if (jumpHorizontal(tileX, tileY, 1, goalX, goalY) >= 0
+			|| jumpHorizontal(tileX, tileY, -1, goalX, goalY) >= 0) {
+			return tileY * mapWidth + tileX;
+		}
+	}
+}
+
+void relaxJumpPoint(SearchContext& context, int current, int currentCost, int jumpPoint, int goalX, int goalY) {
+	if (jumpPoint < 0) {
+		return;
+	}
+	int jumpX = jumpPoint % mapWidth;
+	int jumpY = jumpPoint / mapWidth;
+	int cost = currentCost + distance(current % mapWidth, current / mapWidth, jumpX, jumpY);
+	if (cost < context.Cost(jumpPoint)) {
+		context.Set(jumpPoint, cost, current);
+		context.Push(jumpPoint, cost, cost + distance(jumpX, jumpY, goalX, goalY));
+	}
+}
+
+Direction jumpPointSearch(SearchContext& context, int tileX, int tileY, int goalX, int goalY) {
+	Direction result = DIRECTION_NONE;
+	context.Begin();
+
+	int start = tileY * mapWidth + tileX;
+	context.Set(start, 0, -1);
+	context.Push(start, 0, distance(tileX, tileY, goalX, goalY));
+	bool found = false;
+
+	while (!context.Empty()) {
+		OpenNode node = context.Pop();
+		if (node.cost > context.Cost(node.index)) {
+			continue;
+		}
+		context.nodesExpanded++;
+
+		int current = node.index;
+		int currentX = current % mapWidth;
+		int currentY = current / mapWidth;
+		if (currentX == goalX && currentY == goalY) {
+			found = true;
+			break;
+		}
+
+		// keep going the way we came and look to both sides, the start looks everywhere
+		int parent = context.Parent(current);
+		int dx = 0;
+		int dy = 0;
+		if (parent >= 0) {
+			dx = (currentX > parent % mapWidth) - (currentX < parent % mapWidth);
+			dy = (currentY > parent / mapWidth) - (currentY < parent / mapWidth);
+		}
+		if (dy == 0) {
+			if (dx >= 0) {
+				relaxJumpPoint(context, current, node.cost, jumpHorizontal(currentX, currentY, 1, goalX, goalY), goalX, goalY);
+			}
+			if (dx <= 0) {
+				relaxJumpPoint(context, current, node.cost, jumpHorizontal(currentX, currentY, -1, goalX, goalY), goalX, goalY);
+			}
+		}
+		if (dx == 0) {
+			if (dy >= 0) {
+				relaxJumpPoint(context, current, node.cost, jumpVertical(currentX, currentY, 1, goalX, goalY), goalX, goalY);
+			}
+			if (dy <= 0) {
+				relaxJumpPoint(context, current, node.cost, jumpVertical(currentX, currentY, -1, goalX, goalY), goalX, goalY);
+			}
+		}
+		if (dx != 0) {
+			relaxJumpPoint(context, current, node.cost, jumpVertical(currentX, currentY, 1, goalX, goalY), goalX, goalY);
+			relaxJumpPoint(context, current, node.cost, jumpVertical(currentX, currentY, -1, goalX, goalY), goalX, goalY);
+		}
+		if (dy != 0) {
+			relaxJumpPoint(context, current, node.cost, jumpHorizontal(currentX, currentY, 1, goalX, goalY), goalX, goalY);
+			relaxJumpPoint(context, current, node.cost, jumpHorizontal(currentX, currentY, -1, goalX, goalY), goalX, goalY);
+		}
+	}
+	context.totalNodesExpanded += context.nodesExpanded;
+
+	if (found) {
+		// the first jump point is always in a straight line from the start
+		int current = goalY * mapWidth + goalX;
+		while (current != start && context.Parent(current) != start) {
+			current = context.Parent(current);
+		}
+		int currentX = current % mapWidth;
+		int currentY = current / mapWidth;
+		if (currentX > tileX) {
+			result = DIRECTION_RIGHT;
+		}
+		else if (currentX < tileX) {
+			result = DIRECTION_LEFT;
+		}
+		else if (currentY < tileY) {
+			result = DIRECTION_UP;
+		}
+		else if (currentY > tileY) {
+			result = DIRECTION_DOWN;
+		}
+	}
+	return result;
+}
+
+// hierarchical pathfinding (HPA*) for big levels
+// the map is cut into CLUSTER_SIZE sectors and entrances are placed on the walkable runs
+// along the border of two sectors. the cost between entrances of the same sector is found
+// when the level loads, so a query only searches that small graph and refines the way to
+// the first entrance on the grid. skulls are ignored up here, the grid refinement sees them
+class HierarchicalPlanner {
+public:
+	// grid is the passability the level will be played with, only read here
+	void Build(const PassabilityGrid& grid, int width, int height, int skullCount) {
+		this->width = width;
+		this->height = height;
+		clustersX = (width + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+		clustersY = (height + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+
+		walkable.resize(width * height);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				walkable[y * width + x] = grid.Terrain(x, y);
+			}
+		}
+
+		nodes.clear();
+		freeNodes.clear();
+		verticalBorders.assign(clustersX * clustersY, vector<int>());
+		horizontalBorders.assign(clustersX * clustersY, vector<int>());
+		clusterMembers.assign(clustersX * clustersY, vector<int>());
+
+		for (int cy = 0; cy < clustersY; cy++) {
+			for (int cx = 0; cx < clustersX; cx++) {
+				BuildBorder(true, cx, cy);
+				BuildBorder(false, cx, cy);
+			}
+		}
+		for (int cluster = 0; cluster < clustersX * clustersY; cluster++) {
+			RebuildCluster(cluster);
+		}
+		clustersRebuilt = 0;
+		waypoints.assign(skullCount, Waypoint());
+	}
+
+	// only doors change the terrain, skull and player moves are ignored right away
+	void TileChanged(int tileX, int tileY) {
+		if (walkable.empty()) {
+			return;
+		}
+		int index = tileY * width + tileX;
+		bool now = TerrainWalkable(tileX, tileY);
+		if (now == (walkable[index] != 0)) {
+			return;
+		}
+		walkable[index] = now;
+
+		// rebuild the borders this tile lies on and every cluster sharing them
+		int cx = tileX / CLUSTER_SIZE;
+		int cy = tileY / CLUSTER_SIZE;
+		int touched[3] = { cy * clustersX + cx, -1, -1 };
+		int touchedCount = 1;
+		if (tileX % CLUSTER_SIZE == CLUSTER_SIZE - 1 && cx + 1 < clustersX) {
+			BuildBorder(true, cx, cy);
+			touched[touchedCount++] = cy * clustersX + cx + 1;
+		}
+		else if (tileX % CLUSTER_SIZE == 0 && cx > 0) {
+			BuildBorder(true, cx - 1, cy);
+			touched[touchedCount++] = cy * clustersX + cx - 1;
+		}
+		if (tileY % CLUSTER_SIZE == CLUSTER_SIZE - 1 && cy + 1 < clustersY) {
+			BuildBorder(false, cx, cy);
+			touched[touchedCount++] = (cy + 1) * clustersX + cx;
+		}
+		else if (tileY % CLUSTER_SIZE == 0 && cy > 0) {
+			BuildBorder(false, cx, cy - 1);
+			touched[touchedCount++] = (cy - 1) * clustersX + cx;
+		}
+		for (int i = 0; i < touchedCount; i++) {
+			RebuildCluster(touched[i]);
+		}
+	}
+
+	// each skull keeps the entrance it is heading for until it gets there, and remembers how far
+	// the player was. when a new plan isn't shorter than the last one the abstract graph led it
+	// astray (two borders can take turns), so it plans on the grid until the player changes
+	// cluster. only the waypoint of this skull is written, so skulls can run on any thread
+	Direction Step(SearchContext& context, uint32_t id, int tileX, int tileY, int goalX, int goalY) {
+		if (tileX == goalX && tileY == goalY) {
+			return DIRECTION_NONE;
+		}
+		int goal = goalY * width + goalX;
+		int goalCluster = ClusterOf(goalX, goalY);
+		Waypoint& waypoint = waypoints[id];
+		if (waypoint.goalCluster != goalCluster || waypoint.clustersRebuilt != clustersRebuilt) {
+			waypoint = Waypoint();
+			waypoint.goalCluster = goalCluster;
+			waypoint.clustersRebuilt = clustersRebuilt;
+		}
+		if (waypoint.exact) {
+			return aStarSearch(context, tileX, tileY, goalX, goalY);
+		}
+
+		int cost;
+		Direction result = DIRECTION_NONE;
+		bool sameCluster = ClusterOf(tileX, tileY) == goalCluster;
+		if (sameCluster) {
+			int reached = aStarExpand(context, tileX, tileY, goalX, goalY, INT_MAX);
+			cost = context.Cost(goal);
+			result = firstStep(context, tileX, tileY, reached);
+			waypoint.cell = -1;
+		}
+		else if (waypoint.cell < 0 || waypoint.cell == tileY * width + tileX) {
+			waypoint.cell = FindWaypoint(context.hierarchy, tileX, tileY, goalX, goalY, cost);
+		}
+		else {
+			cost = waypoint.cost - 1;
+		}
+
+		if (waypoint.goal == goal && cost >= waypoint.cost) {
+			waypoint.exact = true;
+			return sameCluster ? result : aStarSearch(context, tileX, tileY, goalX, goalY);
+		}
+		waypoint.goal = goal;
+		waypoint.cost = cost;
+		if (sameCluster) {
+			return result;
+		}
+
+		// only the way to the waypoint is refined on the grid, when a skull stands on it or the
+		// refinement finds no step the skull plans the whole way instead
+		int cell = waypoint.cell;
+		if (cell >= 0 && passability.Open(cell % width, cell / width)) {
+			result = aStarSearch(context, tileX, tileY, cell % width, cell / width);
+		}
+		if (result == DIRECTION_NONE) {
+			waypoint.cell = -1;
+			result = aStarSearch(context, tileX, tileY, goalX, goalY);
+		}
+		return result;
+	}
+
+	// clusters recomputed because of doors since the level was loaded
+	int clustersRebuilt = 0;
+
+private:
+	struct HierarchyNode {
+		int cell;
+		int cluster;
+		int partner; // the entrance on the other side of the border
+		vector<pair<int, int>> edges; // entrances of the same cluster and their cost
+	};
+
+	struct Waypoint {
+		int cell = -1;
+		int goal = -1; // the player tile and the length of the plan at the last step
+		int cost = INT_MAX;
+		bool exact = false;
+		int goalCluster = -1;
+		int clustersRebuilt = 0;
+	};
+
+	// searches the entrance graph and returns the first entrance on the way that isn't the
+	// tile we are standing on, -1 when the goal can't be reached. cost is the length of the
+	// whole way, INT_MAX when there is none
+	int FindWaypoint(HierarchyScratch& scratch, int tileX, int tileY, int goalX, int goalY, int& cost) {
+		int startCluster = ClusterOf(tileX, tileY);
+		int goalCluster = ClusterOf(goalX, goalY);
+		int goalNode = nodes.size();
+		BeginSearch(scratch, goalNode + 1);
+
+		// the goal connects to the entrances of its cluster
+		scratch.goalLinks.clear();
+		ClusterSearch(scratch, goalCluster, goalX, goalY);
+		for (int member : clusterMembers[goalCluster]) {
+			int dist = LocalDistance(scratch, goalCluster, nodes[member].cell);
+			if (dist != INT_MAX) {
+				scratch.goalLinks.push_back(make_pair(member, dist));
+			}
+		}
+
+		// the start connects to the entrances of its cluster
+		ClusterSearch(scratch, startCluster, tileX, tileY);
+		for (int member : clusterMembers[startCluster]) {
+			Relax(scratch, member, -1, LocalDistance(scratch, startCluster, nodes[member].cell), goalX, goalY);
+		}
+
+		bool found = false;
+		vector<OpenNode>& openList = scratch.openList;
+		while (!openList.empty()) {
+			pop_heap(openList.begin(), openList.end(), OpenNodeCompare());
+			OpenNode node = openList.back();
+			openList.pop_back();
+			if (node.cost > scratch.abstractCost[node.index]) {
+				continue;
+			}
+			if (node.index == goalNode) {
+				found = true;
+				break;
+			}
+
+			const HierarchyNode& current = nodes[node.index];
+			Relax(scratch, current.partner, node.index, node.cost + 1, goalX, goalY);
+			for (const pair<int, int>& edge : current.edges) {
+				Relax(scratch, edge.first, node.index, node.cost + edge.second, goalX, goalY);
+			}
+			if (current.cluster == goalCluster) {
+				for (const pair<int, int>& link : scratch.goalLinks) {
+					if (link.first == node.index) {
+						Relax(scratch, goalNode, node.index, node.cost + link.second, goalX, goalY);
+					}
+				}
+			}
+		}
+		if (!found) {
+			cost = INT_MAX;
+			return -1;
+		}
+
+		cost = scratch.abstractCost[goalNode];
+		int first = goalNode;
+		int second = goalNode;
+		while (scratch.abstractParent[first] != -1) {
+			second = first;
+			first = scratch.abstractParent[first];
+		}
+		int waypoint = (first == goalNode) ? goalY * width + goalX : nodes[first].cell;
+		if (waypoint == tileY * width + tileX) {
+			waypoint = (second == goalNode) ? goalY * width + goalX : nodes[second].cell;
+		}
+		return waypoint;
+	}
+
+	bool TerrainWalkable(int tileX, int tileY) const {
+		return passability.Terrain(tileX, tileY);
+	}
+
+	int ClusterOf(int tileX, int tileY) const {
+		return (tileY / CLUSTER_SIZE) * clustersX + tileX / CLUSTER_SIZE;
+	}
+
+	int AddNode(int cell, int cluster) {
+		int id;
+		if (!freeNodes.empty()) {
+			id = freeNodes.back();
+			freeNodes.pop_back();
+		}
+		else {
+			id = nodes.size();
+			nodes.push_back(HierarchyNode());
+		}
+		nodes[id].cell = cell;
+		nodes[id].cluster = cluster;
+		nodes[id].partner = -1;
+		nodes[id].edges.clear();
+		return id;
+	}
+
+	void AddTransition(vector<int>& border, int firstCell, int secondCell) {
+		int first = AddNode(firstCell, ClusterOf(firstCell % width, firstCell / width));
+		int second = AddNode(secondCell, ClusterOf(secondCell % width, secondCell / width));
+		nodes[first].partner = second;
+		nodes[second].partner = first;
+		border.push_back(first);
+		border.push_back(second);
+	}
+
+	// vertical borders lie between a cluster and the one to its right, horizontal ones below it
+	void BuildBorder(bool vertical, int cx, int cy) {
+		if ((vertical && cx + 1 >= clustersX) || (!vertical && cy + 1 >= clustersY)) {
+			return;
+		}
+		vector<int>& border = vertical ? verticalBorders[cy * clustersX + cx] : horizontalBorders[cy * clustersX + cx];
+		for (int id : border) {
+			nodes[id].cell = -1;
+			freeNodes.push_back(id);
+		}
+		border.clear();
+
+		int length = vertical ? min(CLUSTER_SIZE, height - cy * CLUSTER_SIZE) : min(CLUSTER_SIZE, width - cx * CLUSTER_SIZE);
+		int runStart = -1;
+		for (int i = 0; i <= length; i++) {
+			int firstCell = -1;
+			int secondCell = -1;
+			bool open = false;
+			if (i < length) {
+				if (vertical) {
+					int x = (cx + 1) * CLUSTER_SIZE - 1;
+					int y = cy * CLUSTER_SIZE + i;
+					firstCell = y * width + x;
+					secondCell = firstCell + 1;
+				}
+				else {
+					int x = cx * CLUSTER_SIZE + i;
+					int y = (cy + 1) * CLUSTER_SIZE - 1;
+					firstCell = y * width + x;
+					secondCell = firstCell + width;
+				}
+				open = walkable[firstCell] && walkable[secondCell];
+			}
+
+			if (open && runStart < 0) {
+				runStart = i;
+			}
+			else if (!open && runStart >= 0) {
+				// long openings get an entrance at each end, short ones one in the middle
+				int step = vertical ? width : 1;
+				int offset = vertical ? 1 : width;
+				int runFirst = vertical ? (cy * CLUSTER_SIZE + runStart) * width + (cx + 1) * CLUSTER_SIZE - 1
+					: ((cy + 1) * CLUSTER_SIZE - 1) * width + cx * CLUSTER_SIZE + runStart;
+				int runLength = i - runStart;
+				if (runLength > 5) {
+					AddTransition(border, runFirst, runFirst + offset);
+					AddTransition(border, runFirst + (runLength - 1) * step, runFirst + (runLength - 1) * step + offset);
+				}
+				else {
+					AddTransition(border, runFirst + (runLength / 2) * step, runFirst + (runLength / 2) * step + offset);
+				}
+				runStart = -1;
+			}
+		}
+	}
+
+	void CollectMembers(const vector<int>& border, int cluster) {
+		for (int id : border) {
+			if (nodes[id].cluster == cluster) {
+				clusterMembers[cluster].push_back(id);
+			}
+		}
+	}
+
+	// recomputes the entrances of a cluster and the costs between them
+	void RebuildCluster(int cluster) {
+		clustersRebuilt++;
+		int cx = cluster % clustersX;
+		int cy = cluster / clustersX;
+		clusterMembers[cluster].clear();
+		CollectMembers(verticalBorders[cluster], cluster);
+		CollectMembers(horizontalBorders[cluster], cluster);
+		if (cx > 0) {
+			CollectMembers(verticalBorders[cluster - 1], cluster);
+		}
+		if (cy > 0) {
+			CollectMembers(horizontalBorders[cluster - clustersX], cluster);
+		}
+
+		for (int member : clusterMembers[cluster]) {
+			nodes[member].edges.clear();
+		}
+		for (int member : clusterMembers[cluster]) {
+			ClusterSearch(buildScratch, cluster, nodes[member].cell % width, nodes[member].cell / width);
+			for (int other : clusterMembers[cluster]) {
+				int dist = LocalDistance(buildScratch, cluster, nodes[other].cell);
+				if (other != member && dist != INT_MAX) {
+					nodes[member].edges.push_back(make_pair(other, dist));
+				}
+			}
+		}
+	}
+
+	// breadth first search that never leaves the cluster
+	void ClusterSearch(HierarchyScratch& scratch, int cluster, int tileX, int tileY) {
+		vector<int>& clusterDistance = scratch.clusterDistance;
+		vector<int>& clusterQueue = scratch.clusterQueue;
+		clusterDistance.resize(CLUSTER_SIZE * CLUSTER_SIZE);
+		clusterQueue.resize(CLUSTER_SIZE * CLUSTER_SIZE);
+		int left = (cluster % clustersX) * CLUSTER_SIZE;
+		int top = (cluster / clustersX) * CLUSTER_SIZE;
+		int right = min(left + CLUSTER_SIZE, width);
+		int bottom = min(top + CLUSTER_SIZE, height);
+		fill(clusterDistance.begin(), clusterDistance.end(), INT_MAX);
+
+		int head = 0;
+		int tail = 0;
+		clusterDistance[(tileY - top) * CLUSTER_SIZE + tileX - left] = 0;
+		clusterQueue[tail++] = tileY * width + tileX;
+		while (head < tail) {
+			int current = clusterQueue[head++];
+			int currentX = current % width;
+			int currentY = current / width;
+			int nextDist = clusterDistance[(currentY - top) * CLUSTER_SIZE + currentX - left] + 1;
+
+			const int offsetX[] = { 0, 0, 1, -1 };
+			const int offsetY[] = { 1, -1, 0, 0 };
+			for (int i = 0; i < 4; i++) {
+				int checkX = currentX + offsetX[i];
+				int checkY = currentY + offsetY[i];
+				if (checkX < left || checkY < top || checkX >= right || checkY >= bottom
+					|| !walkable[checkY * width + checkX]) {
+					continue;
+				}
+				int local = (checkY - top) * CLUSTER_SIZE + checkX - left;
+				if (clusterDistance[local] == INT_MAX) {
+					clusterDistance[local] = nextDist;
+					clusterQueue[tail++] = checkY * width + checkX;
+				}
+			}
+		}
+	}
+
+	int LocalDistance(const HierarchyScratch& scratch, int cluster, int cell) const {
+		int left = (cluster % clustersX) * CLUSTER_SIZE;
+		int top = (cluster / clustersX) * CLUSTER_SIZE;
+		return scratch.clusterDistance[(cell / width - top) * CLUSTER_SIZE + cell % width - left];
+	}
+
+	void BeginSearch(HierarchyScratch& scratch, int nodeCount) {
+		if ((int)scratch.abstractCost.size() < nodeCount) {
+			scratch.abstractCost.resize(nodeCount);
+			scratch.abstractParent.resize(nodeCount);
+			scratch.openList.reserve(nodeCount * 4);
+		}
+		fill(scratch.abstractCost.begin(), scratch.abstractCost.begin() + nodeCount, INT_MAX);
+		scratch.openList.clear();
+	}
+
+	void Relax(HierarchyScratch& scratch, int id, int parent, int cost, int goalX, int goalY) {
+		if (cost == INT_MAX || cost >= scratch.abstractCost[id]) {
+			return;
+		}
+		if (id < (int)nodes.size() && nodes[id].cell < 0) {
+			return;
+		}
+		scratch.abstractCost[id] = cost;
+		scratch.abstractParent[id] = parent;
+		int cell = (id < (int)nodes.size()) ? nodes[id].cell : goalY * width + goalX;
+		OpenNode node = { id, cost, cost + distance(cell % width, cell / width, goalX, goalY) };
+		scratch.openList.push_back(node);
+		push_heap(scratch.openList.begin(), scratch.openList.end(), OpenNodeCompare());
+	}
+
+	int width = 0;
+	int height = 0;
+	int clustersX = 0;
+	int clustersY = 0;
+	vector<char> walkable;
+	vector<HierarchyNode> nodes;
+	vector<int> freeNodes;
+	vector<vector<int>> verticalBorders;
+	vector<vector<int>> horizontalBorders;
+	vector<vector<int>> clusterMembers;
+
+	vector<Waypoint> waypoints; // by skull id
+
+	// for the cluster searches of Build and TileChanged, queries use the one in their context
+	HierarchyScratch buildScratch;
+};
+
+HierarchicalPlanner hierarchicalPlanner;
+
+// distance from the player to the tiles around it, shared by all chasing skulls
+// skulls don't block the field, they are only checked when a skull picks its step
+// the search stops once every chaser is reached and picks up from there if another skull starts chasing
+vector<int> playerDistance;
+vector<int> distanceQueue; // every tile with a distance, in the order they were reached
+int distanceHead = 0;
+int distanceTail = 0;
+int distanceFieldX = -1;
+int distanceFieldY = -1;
+bool distanceFieldDirty = true;
+
+void resizePlayerDistanceField() {
+	playerDistance.assign(mapWidth * mapHeight, INT_MAX);
+	distanceQueue.resize(mapWidth * mapHeight);
+	distanceHead = 0;
+	distanceTail = 0;
+	distanceFieldDirty = true;
+}
+
+// call whenever a door opens or closes
+void invalidatePlayerDistanceField() {
+	distanceFieldDirty = true;
+}
+
+void visitDistanceTile(int tileX, int tileY, int dist) {
+	if (!passability.Terrain(tileX, tileY)) {
+		return;
+	}
+	int index = tileY * mapWidth + tileX;
+	if (playerDistance[index] != INT_MAX) {
+		return;
+	}
+	playerDistance[index] = dist;
+	distanceQueue[distanceTail++] = index;
+}
+
+// breadth first search out from the player, restarted only when the player moved or a door changed
+void resetPlayerDistanceField(int playerX, int playerY) {
+	// only the tiles reached last time have to be cleared
+	for (int i = 0; i < distanceTail; i++) {
+		playerDistance[distanceQueue[i]] = INT_MAX;
+	}
+	distanceHead = 0;
+	distanceTail = 0;
+	playerDistance[playerY * mapWidth + playerX] = 0;
+	distanceQueue[distanceTail++] = playerY * mapWidth + playerX;
+
+	distanceFieldX = playerX;
+	distanceFieldY = playerY;
+	distanceFieldDirty = false;
+}
+
+// grows the search until the tile has its distance or nothing more can be reached
+// every tile one step closer to the player has its distance by then, which is all flowFieldStep reads
+void reachDistanceTile(int tileX, int tileY) {
+	int target = tileY * mapWidth + tileX;
+	while (playerDistance[target] == INT_MAX && distanceHead < distanceTail) {
+		int current = distanceQueue[distanceHead++];
+		int currentX = current % mapWidth;
+		int currentY = current / mapWidth;
+		int nextDist = playerDistance[current] + 1;
+
+		visitDistanceTile(currentX, currentY + 1, nextDist);
+		visitDistanceTile(currentX, currentY - 1, nextDist);
+		visitDistanceTile(currentX + 1, currentY, nextDist);
+		visitDistanceTile(currentX - 1, currentY, nextDist);
+	}
+}
+
+// pick the free neighbour that is closest to the player, O(1) per skull
+// the field goes straight through other skulls, so when the only way closer is taken by one
+// the skull plans around the crowd with aStarSearch instead of queueing behind it
+Direction flowFieldStep(SearchContext& context, int tileX, int tileY, int goalX, int goalY) {
+	Direction result = DIRECTION_NONE;
+	int current = playerDistance[tileY * mapWidth + tileX];
+	int best = current;
+	bool blocked = false;
+
+	const int offsetX[] = { 0, 0, 1, -1 };
+	const int offsetY[] = { 1, -1, 0, 0 };
+	const Direction directions[] = { DIRECTION_DOWN, DIRECTION_UP, DIRECTION_RIGHT, DIRECTION_LEFT };
+	for (int i = 0; i < 4; i++) {
+		int checkX = tileX + offsetX[i];
+		int checkY = tileY + offsetY[i];
+		int checkDistance = playerDistance[checkY * mapWidth + checkX];
+		if (!passability.Open(checkX, checkY)) {
+			if (passability.Terrain(checkX, checkY) && checkDistance < current) {
+				blocked = true;
+			}
+			continue;
+		}
+		if (checkDistance < best) {
+			best = checkDistance;
+			result = directions[i];
+		}
+	}
+	if (result == DIRECTION_NONE && blocked) {
+		return aStarSearch(context, tileX, tileY, goalX, goalY);
+	}
+	return result;
+}
+
+// incremental replanning from the cells that changed since the last turn
+// every chasing skull keeps the A* path it found and the turn only repairs what moved:
+// the player's step extends or trims the end, a skull standing on the next tile is walked
+// around with a small search that rejoins the path, and a door opening replans everyone.
+// a full A* only runs when a repair fails or the path has been extended too often
+class IncrementalPlanner {
+public:
+	void Reset(int skullCount) {
+		paths.assign(skullCount, CachedPath());
+		terrainChanges = 0;
+	}
+
+	// doors opening or closing can make any cached path wrong or too long
+	void TerrainChanged() {
+		terrainChanges++;
+	}
+
+	// only touches the path of this skull, so skulls can be stepped on different threads
+	Direction Step(SearchContext& context, uint32_t id, int tileX, int tileY, int goalX, int goalY) {
+		CachedPath& path = paths[id];
+		int width = context.width;
+		int start = tileY * width + tileX;
+		int goal = goalY * width + goalX;
+		if (start == goal) {
+			return DIRECTION_NONE;
+		}
+
+		bool valid = path.valid && path.terrainChanges == terrainChanges && Follow(path, start) && Retarget(path, goal, width);
+		if (valid && !passability.Open(path.cells[path.next] % width, path.cells[path.next] / width)) {
+			valid = Splice(context, path, tileX, tileY);
+		}
+		if (!valid) {
+			int reached = Plan(context, path, tileX, tileY, goalX, goalY);
+			if (reached != goal) {
+				// the player can't be reached, head wherever A* got closest
+				return firstStep(context, tileX, tileY, reached);
+			}
+		}
+
+		int next = path.cells[path.next];
+		return directionTo(tileX, tileY, next % width, next / width);
+	}
+
+private:
+	// cells[next] is the tile after start, the last cell is the player's tile
+	struct CachedPath {
+		vector<int> cells;
+		int next = 0;
+		int start = -1;
+		int extensions = 0;
+		unsigned terrainChanges = 0;
+		bool valid = false;
+	};
+
+	// player steps the end can follow before the path is planned again, each one can add a detour
+	static const int MAX_EXTENSIONS = 8;
+	// tiles a repair may expand to get around a blocked step
+	static const int SPLICE_LIMIT = 64;
+
+	// the skull either stayed or took the step the path gave it
+	bool Follow(CachedPath& path, int start) {
+		if (start == path.start) {
+			return true;
+		}
+		if (path.cells[path.next] == start && path.next + 1 < (int)path.cells.size()) {
+			path.start = start;
+			path.next++;
+			return true;
+		}
+		return false;
+	}
+
+	// the player is one step from where the path ended, or went back along it
+	bool Retarget(CachedPath& path, int goal, int width) {
+		int end = path.cells.back();
+		if (end == goal) {
+			return true;
+		}
+		for (int i = path.next; i < (int)path.cells.size(); i++) {
+			if (path.cells[i] == goal) {
+				path.cells.resize(i + 1);
+				return true;
+			}
+		}
+		if (path.extensions >= MAX_EXTENSIONS || distance(end % width, end / width, goal % width, goal / width) != 1) {
+			return false;
+		}
+		path.cells.push_back(goal);
+		path.extensions++;
+		return true;
+	}
+
+	// walks around whatever stands on the next tile to the first open tile after it
+	bool Splice(SearchContext& context, CachedPath& path, int tileX, int tileY) {
+		int width = context.width;
+		int rejoin = path.next;
+		while (rejoin + 1 < (int)path.cells.size() && !passability.Open(path.cells[rejoin] % width, path.cells[rejoin] / width)) {
+			rejoin++;
+		}
+		int target = path.cells[rejoin];
+		if (aStarExpand(context, tileX, tileY, target % width, target / width, SPLICE_LIMIT) != target) {
+			return false;
+		}
+
+		// the detour takes the place of everything before the rejoining tile
+		int length = 0;
+		for (int cell = context.Parent(target); cell != path.start; cell = context.Parent(cell)) {
+			length++;
+		}
+		path.cells.erase(path.cells.begin(), path.cells.begin() + rejoin);
+		path.cells.insert(path.cells.begin(), length, 0);
+		int position = length;
+		for (int cell = context.Parent(target); cell != path.start; cell = context.Parent(cell)) {
+			path.cells[--position] = cell;
+		}
+		path.next = 0;
+		return true;
+	}
+
+	// returns the tile the search ended on, the path is only kept when that is the goal
+	int Plan(SearchContext& context, CachedPath& path, int tileX, int tileY, int goalX, int goalY) {
+		int width = context.width;
+		int start = tileY * width + tileX;
+		int goal = goalY * width + goalX;
+		path.valid = false;
+		int reached = aStarExpand(context, tileX, tileY, goalX, goalY, INT_MAX);
+		if (reached != goal) {
+			return reached;
+		}
+
+		path.cells.clear();
+		for (int cell = goal; cell != start; cell = context.Parent(cell)) {
+			path.cells.push_back(cell);
+		}
+		reverse(path.cells.begin(), path.cells.end());
+		path.next = 0;
+		path.start = start;
+		path.extensions = 0;
+		path.terrainChanges = terrainChanges;
+		path.valid = true;
+		return reached;
+	}
+
+	vector<CachedPath> paths;
+	unsigned terrainChanges = 0;
+};
+
+IncrementalPlanner incrementalPlanner;
+
+// tiles the player can see, found with recursive shadowcasting once per player move
+// walls and closed doors block the view, idle skulls wake up when their tile is visible
+class FieldOfView {
+public:
+	void Resize(int width, int height) {
+		this->width = width;
+		this->height = height;
+		stamp.assign(width * height, 0);
+		generation = 0;
+	}
+
+	void Compute(int tileX, int tileY, int radius) {
+		generation++;
+		if (generation == 0) {
+			fill(stamp.begin(), stamp.end(), 0);
+			generation = 1;
+		}
+		tilesVisible = 0;
+		SetVisible(tileX, tileY);
+
+		// multipliers turning the first octant into each of the eight
+		const int xx[] = { 1, 0, 0, -1, -1, 0, 0, 1 };
+		const int xy[] = { 0, 1, -1, 0, 0, -1, 1, 0 };
+		const int yx[] = { 0, 1, 1, 0, 0, -1, -1, 0 };
+		const int yy[] = { 1, 0, 0, 1, -1, 0, 0, -1 };
+		for (int octant = 0; octant < 8; octant++) {
+			CastLight(tileX, tileY, 1, 1.0f, 0.0f, radius, xx[octant], xy[octant], yx[octant], yy[octant]);
+		}
+	}
+
+	bool Visible(int tileX, int tileY) const {
+		return stamp[tileY * width + tileX] == generation;
+	}
+
+	int tilesVisible = 0;
+
+private:
+	bool Opaque(int tileX, int tileY) const {
+		if (tileX < 0 || tileY < 0 || tileX >= width || tileY >= height) {
+			return true;
+		}
+		return !passability.Terrain(tileX, tileY);
+	}
+
+	void SetVisible(int tileX, int tileY) {
+		if (tileX < 0 || tileY < 0 || tileX >= width || tileY >= height) {
+			return;
+		}
+		if (stamp[tileY * width + tileX] != generation) {
+			stamp[tileY * width + tileX] = generation;
+			tilesVisible++;
+		}
+	}
+
+	// scans one octant row by row, a wall splits the lit slope range and the part
+	// behind it is handled by a recursive call
+	void CastLight(int originX, int originY, int row, float startSlope, float endSlope, int radius,
+		int xx, int xy, int yx, int yy) {
+		if (startSlope < endSlope) {
+			return;
+		}
+		float nextStartSlope = startSlope;
+		for (int depth = row; depth <= radius; depth++) {
+			bool blocked = false;
+			int dy = -depth;
+			for (int dx = -depth; dx <= 0; dx++) {
+				int tileX = originX + dx * xx + dy * xy;
+				int tileY = originY + dx * yx + dy * yy;
+				float leftSlope = (dx - 0.5f) / (dy + 0.5f);
+				float rightSlope = (dx + 0.5f) / (dy - 0.5f);
+				if (startSlope < rightSlope) {
+					continue;
+				}
+				else if (endSlope > leftSlope) {
+					break;
+				}
+
+				if (dx * dx + dy * dy <= radius * radius) {
+					SetVisible(tileX, tileY);
+				}
+
+				if (blocked) {
+					if (Opaque(tileX, tileY)) {
+						nextStartSlope = rightSlope;
+						continue;
+					}
+					blocked = false;
+					startSlope = nextStartSlope;
+				}
+				else if (Opaque(tileX, tileY) && depth < radius) {
+					blocked = true;
+					CastLight(originX, originY, depth + 1, startSlope, leftSlope, radius, xx, xy, yx, yy);
+					nextStartSlope = rightSlope;
+				}
+			}
+			if (blocked) {
+				break;
+			}
+		}
+	}
+
+	int width = 0;
+	int height = 0;
+	vector<unsigned> stamp;
+	unsigned generation = 0;
+};
+
+FieldOfView playerView;
+int playerViewX = -1;
+int playerViewY = -1;
+bool playerViewDirty = true;
+
+void invalidatePlayerView() {
+	playerViewDirty = true;
+}
+
+// called for every change to entityPositionData after the level is loaded
+void tileChanged(int tileX, int tileY) {
+	bool terrainBefore = passability.Terrain(tileX, tileY);
+	passability.Update(tileX, tileY);
+	if (passability.Terrain(tileX, tileY) != terrainBefore) {
+		// a door opened or closed
+		invalidatePlayerDistanceField();
+		invalidatePlayerView();
+		incrementalPlanner.TerrainChanged();
+	}
+	hierarchicalPlanner.TileChanged(tileX, tileY);
+}
+
+void Entity::Update(float elapsed) {
+	if (!isStatic) {
+		// check which movement is allowed
+		int tileX, tileY;
+		worldToTileCoordinates(position.x, position.y, tileX, tileY);
+
+		rightBlocked = !passability.Open(tileX + 1, tileY);
+		leftBlocked = !passability.Open(tileX - 1, tileY);
+		upBlocked = !passability.Open(tileX, tileY - 1);
+		downBlocked = !passability.Open(tileX, tileY + 1);
+
+		if (entityType == ENTITY_SKULL && currentState == ENTITY_IDLE) {
+			// change entity state to chasing if the player can see us
+			if (playerView.Visible(tileX, tileY)) {
+				currentState = ENTITY_CHASE;
+			}
+		}
+	}
+}
+
+void Entity::clearPositionData() {
+	int tileX, tileY;
+	worldToTileCoordinates(position.x, position.y, tileX, tileY);
+	entityPositionData[tileY][tileX] = ENTITY_NONE;
+	tileChanged(tileX, tileY);
+}
+
+void Entity::setPositionData() {
+	int tileX, tileY;
+	worldToTileCoordinates(position.x, position.y, tileX, tileY);
+	entityPositionData[tileY][tileX] = entityType;
+	tileChanged(tileX, tileY);
+}
+
+// first half of a skull's turn, it only reads the board so every skull can decide at once
+Direction Entity::ProposeMove(int playerTileX, int playerTileY, SearchContext& context) const {
+	int thisTileX, thisTileY;
+	worldToTileCoordinates(position.x, position.y, thisTileX, thisTileY);
+
+	if (currentState == ENTITY_CHASE) {
+		// move towards the player
+		if (pathMode == PATH_FLOW_FIELD) {
+			return flowFieldStep(context, thisTileX, thisTileY, playerTileX, playerTileY);
+		}
+		else if (pathMode == PATH_INCREMENTAL) {
+			return incrementalPlanner.Step(context, id, thisTileX, thisTileY, playerTileX, playerTileY);
+		}
+		else if (pathMode == PATH_HIERARCHICAL) {
+			return hierarchicalPlanner.Step(context, id, thisTileX, thisTileY, playerTileX, playerTileY);
+		}
+		else if (pathMode == PATH_JPS) {
+			return jumpPointSearch(context, thisTileX, thisTileY, playerTileX, playerTileY);
+		}
+		// A* search is not really necessary since skull only sees player if within 2 tile distance
+		// and the walls are at least 2 tiles wide
+		return aStarSearch(context, thisTileX, thisTileY, playerTileX, playerTileY);
+	}
+
+	// pick a random nonblocked direction and move that way
+	Direction potentialDirections[4];
+	int directionCount = 0;
+	if (passability.Open(thisTileX - 1, thisTileY)) {
+		potentialDirections[directionCount++] = DIRECTION_LEFT;
+	}
+	if (passability.Open(thisTileX + 1, thisTileY)) {
+		potentialDirections[directionCount++] = DIRECTION_RIGHT;
+	}
+	if (passability.Open(thisTileX, thisTileY - 1)) {
+		potentialDirections[directionCount++] = DIRECTION_UP;
+	}
+	if (passability.Open(thisTileX, thisTileY + 1)) {
+		potentialDirections[directionCount++] = DIRECTION_DOWN;
+	}
+
+	if (directionCount == 0) {
+		// no movement if no moves available
+		return DIRECTION_NONE;
+	}
+	return potentialDirections[TurnRandom() % directionCount];
+}
+
+// a random number for this skull that stays the same however the turn is scheduled
+uint32_t Entity::TurnRandom() const {
+	return philox(turnNumber, id, levelSeed);
+}
+
+// second half, commits the move once the skull won its target tile
+void Entity::ApplyMove(Direction next) {
+	if (next == DIRECTION_NONE) {
+		return;
+	}
+
+	clearPositionData();
+	// make the move
+	if (next == DIRECTION_LEFT) {
+		position.x -= MAP_TILE_SIZE;
+		faceRight = false;
+	}
+	else if (next == DIRECTION_RIGHT) {
+		position.x += MAP_TILE_SIZE;
+		faceRight = true;
+	}
+	else if (next == DIRECTION_UP) {
+		position.y += MAP_TILE_SIZE;
+	}
+	else if (next == DIRECTION_DOWN) {
+		position.y -= MAP_TILE_SIZE;
+	}
+	setPositionData();
+}
+
+bool Entity::collided(Entity& other) {
+	// just check if occupying the same tile
+	int thisTileX, thisTileY, otherTileX, otherTileY;
+	worldToTileCoordinates(position.x, position.y, thisTileX, thisTileY);
+	worldToTileCoordinates(other.position.x, other.position.y, otherTileX, otherTileY);
+
+	return ((thisTileX == otherTileX) && (thisTileY == otherTileY));
+}
+
+Entity player;
+vector<Entity> enemies;
+vector<Entity> torches;
+vector<Entity> keysVector;
+vector<Entity> doors;
+Entity exitLadder;
+vector<Entity> swords;
+
+// recomputes what the player sees, only after the player moved or a door opened
+void updatePlayerView() {
+	int tileX, tileY;
+	worldToTileCoordinates(player.position.x, player.position.y, tileX, tileY);
+	if (!playerViewDirty && tileX == playerViewX && tileY == playerViewY) {
+		return;
+	}
+	playerView.Compute(tileX, tileY, SIGHT_RADIUS);
+	playerViewX = tileX;
+	playerViewY = tileY;
+	playerViewDirty = false;
+}
+
+// skulls move in two phases so the outcome never depends on who moves first
+// every skull proposes a step against the board as the player left it, then contested tiles
+// go to the skull with the highest priority and the winners are committed in order
+struct MoveProposal {
+	Direction direction;
+	int target; // tile index, -1 when staying put
+};
+
+vector<MoveProposal> proposals;
+vector<int> tileClaims; // skull holding a tile this turn, -1 when unclaimed
+vector<SearchContext> workerContexts; // one per extra thread, the calling thread uses searchContext
+bool workerContextsSized = false;
+
+void proposeEnemyMoves(unsigned begin, unsigned end, int playerTileX, int playerTileY, SearchContext* context);
+
+// threads that propose skull moves for the big levels, started once and parked between turns
+// so a turn only pays for waking them up
+class EnemyWorkers {
+public:
+	~EnemyWorkers() {
+		{
+			lock_guard<mutex> lock(turnMutex);
+			quit = true;
+		}
+		turnStarted.notify_all();
+		for (unsigned i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+	}
+
+	void Start(unsigned count) {
+		for (unsigned i = workers.size(); i < count; i++) {
+			workers.push_back(thread(&EnemyWorkers::Work, this, i));
+		}
+	}
+
+	unsigned Count() const {
+		return workers.size();
+	}
+
+	// worker t takes chunk t + 1, the caller does chunk 0 and then waits for the rest
+	void Run(unsigned count, unsigned chunk, int playerTileX, int playerTileY) {
+		{
+			lock_guard<mutex> lock(turnMutex);
+			skullCount = count;
+			skullChunk = chunk;
+			playerX = playerTileX;
+			playerY = playerTileY;
+			running = workers.size();
+			turn++;
+		}
+		turnStarted.notify_all();
+		proposeEnemyMoves(0, min(count, chunk), playerTileX, playerTileY, &searchContext);
+
+		unique_lock<mutex> lock(turnMutex);
+		turnFinished.wait(lock, [this] { return running == 0; });
+	}
+
+private:
+	void Work(unsigned index) {
+		unsigned lastTurn = 0;
+		for (;;) {
+			unique_lock<mutex> lock(turnMutex);
+			turnStarted.wait(lock, [&] { return quit || turn != lastTurn; });
+			if (quit) {
+				return;
+			}
+			lastTurn = turn;
+			unsigned begin = min(skullCount, (index + 1) * skullChunk);
+			unsigned end = min(skullCount, begin + skullChunk);
+			int tileX = playerX;
+			int tileY = playerY;
+			lock.unlock();
+
+			proposeEnemyMoves(begin, end, tileX, tileY, &workerContexts[index]);
+
+			lock.lock();
+			if (--running == 0) {
+				turnFinished.notify_one();
+			}
+		}
+	}
+
+	vector<thread> workers;
+	mutex turnMutex;
+	condition_variable turnStarted;
+	condition_variable turnFinished;
+	unsigned turn = 0;
+	unsigned running = 0;
+	unsigned skullCount = 0;
+	unsigned skullChunk = 0;
+	int playerX = 0;
+	int playerY = 0;
+	bool quit = false;
+};
+
+EnemyWorkers enemyWorkers;
+
+void resizeEnemyTurn() {
+	tileClaims.assign(mapWidth * mapHeight, -1);
+	unsigned threads = max(1u, thread::hardware_concurrency());
+	enemyWorkers.Start(threads - 1);
+
+	// the contexts are only sized by the first turn that runs in parallel, most levels never do
+	workerContexts.resize(threads - 1);
+	workerContextsSized = false;
+}
+
+// chasing skulls go first, then whoever is closer to the player, then the older skull
+bool outranks(int first, int second, int playerTileX, int playerTileY) {
+	bool firstChasing = enemies[first].currentState == ENTITY_CHASE;
+	bool secondChasing = enemies[second].currentState == ENTITY_CHASE;
+	if (firstChasing != secondChasing) {
+		return firstChasing;
+	}
+
+	int firstX, firstY, secondX, secondY;
+	worldToTileCoordinates(enemies[first].position.x, enemies[first].position.y, firstX, firstY);
+	worldToTileCoordinates(enemies[second].position.x, enemies[second].position.y, secondX, secondY);
+	int firstDistance = abs(firstX - playerTileX) + abs(firstY - playerTileY);
+	int secondDistance = abs(secondX - playerTileX) + abs(secondY - playerTileY);
+	if (firstDistance != secondDistance) {
+		return firstDistance < secondDistance;
+	}
+	return first < second;
+}
+
+void proposeEnemyMoves(unsigned begin, unsigned end, int playerTileX, int playerTileY, SearchContext* context) {
+	for (unsigned i = begin; i < end; i++) {
+		Direction next = enemies[i].ProposeMove(playerTileX, playerTileY, *context);
+		int tileX, tileY;
+		worldToTileCoordinates(enemies[i].position.x, enemies[i].position.y, tileX, tileY);
+		if (next == DIRECTION_LEFT) {
+			tileX--;
+		}
+		else if (next == DIRECTION_RIGHT) {
+			tileX++;
+		}
+		else if (next == DIRECTION_UP) {
+			tileY--;
+		}
+		else if (next == DIRECTION_DOWN) {
+			tileY++;
+		}
+		proposals[i].direction = next;
+		proposals[i].target = next == DIRECTION_NONE ? -1 : tileY * mapWidth + tileX;
+	}
+}
+
+// moves every skull once, called after each player action
+void resolveEnemyTurn() {
+	int playerTileX, playerTileY;
+	worldToTileCoordinates(player.position.x, player.position.y, playerTileX, playerTileY);
+	unsigned count = enemies.size();
+	proposals.resize(count);
+
+	// anything that writes shared state happens here, before the skulls start deciding
+	if (pathMode == PATH_FLOW_FIELD) {
+		bool fieldReset = false;
+		for (unsigned i = 0; i < count; i++) {
+			if (enemies[i].currentState != ENTITY_CHASE) {
+				continue;
+			}
+			// nothing is searched on turns without a chaser
+			if (!fieldReset && (distanceFieldDirty || playerTileX != distanceFieldX || playerTileY != distanceFieldY)) {
+				resetPlayerDistanceField(playerTileX, playerTileY);
+			}
+			fieldReset = true;
+			int tileX, tileY;
+			worldToTileCoordinates(enemies[i].position.x, enemies[i].position.y, tileX, tileY);
+			reachDistanceTile(tileX, tileY);
+		}
+	}
+
+	if (count < PARALLEL_ENEMY_THRESHOLD || enemyWorkers.Count() == 0) {
+		proposeEnemyMoves(0, count, playerTileX, playerTileY, &searchContext);
+	}
+	else {
+		if (!workerContextsSized) {
+			for (unsigned i = 0; i < workerContexts.size(); i++) {
+				workerContexts[i].Resize(mapWidth, mapHeight);
+			}
+			workerContextsSized = true;
+		}
+		unsigned threads = enemyWorkers.Count() + 1;
+		enemyWorkers.Run(count, (count + threads - 1) / threads, playerTileX, playerTileY);
+	}
+
+	// every target was open when the turn started, so only skulls aiming at the same tile conflict
+	for (unsigned i = 0; i < count; i++) {
+		int target = proposals[i].target;
+		if (target >= 0 && (tileClaims[target] < 0 || outranks(i, tileClaims[target], playerTileX, playerTileY))) {
+			tileClaims[target] = i;
+		}
+	}
+
+	// commit in index order so tile changes reach the planners the same way every run
+	for (unsigned i = 0; i < count; i++) {
+		int target = proposals[i].target;
+		if (target >= 0 && tileClaims[target] == (int)i) {
+			enemies[i].ApplyMove(proposals[i].direction);
+		}
+	}
+	for (unsigned i = 0; i < count; i++) {
+		if (proposals[i].target >= 0) {
+			tileClaims[proposals[i].target] = -1;
+		}
+	}
+	turnNumber++;
+}
+
+bool Entity::placeKey(Direction d) {
+	if (keyCount > 0) {
+		int tileX, tileY;
+		worldToTileCoordinates(position.x, position.y, tileX, tileY);
+
+		switch (d) {
+		case DIRECTION_UP:
+			if (entityPositionData[tileY - 1][tileX] == ENTITY_DOOR) {
+				keysVector.push_back(Entity(glm::vec3(position.x, position.y + MAP_TILE_SIZE, 1),
+					glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_KEY, true));
+				keyCount--;
+				return true;
+			}
+			break;
+		case DIRECTION_DOWN:
+			if (entityPositionData[tileY + 1][tileX] == ENTITY_DOOR) {
+				keysVector.push_back(Entity(glm::vec3(position.x, position.y - MAP_TILE_SIZE, 1),
+					glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_KEY, true));
+				keyCount--;
+				return true;
+			}
+			break;
+		case DIRECTION_LEFT:
+			if (entityPositionData[tileY][tileX - 1] == ENTITY_DOOR) {
+				keysVector.push_back(Entity(glm::vec3(position.x - MAP_TILE_SIZE, position.y, 1),
+					glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_KEY, true));
+				keyCount--;
+				return true;
+			}
+			break;
+		case DIRECTION_RIGHT:
+			if (entityPositionData[tileY][tileX + 1] == ENTITY_DOOR) {
+				keysVector.push_back(Entity(glm::vec3(position.x + MAP_TILE_SIZE, position.y, 1),
+					glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_KEY, true));
+				keyCount--;
+				return true;
+			}
+			break;
+		}
+	}
+	return false;
+}
+
+bool Entity::attack(Direction d) {
+	int tileX, tileY;
+	worldToTileCoordinates(position.x, position.y, tileX, tileY);
+
+	switch (d) {
+	case DIRECTION_UP:
+		if (entityPositionData[tileY - 1][tileX] == ENTITY_SKULL) {
+			swords.push_back(Entity(glm::vec3(position.x, position.y + MAP_TILE_SIZE, 1),
+				glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_SWORD, true));
+			swords[swords.size() - 1].sprite = SheetSprite(swordSprite, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f);
+			return true;
+		}
+		break;
+	case DIRECTION_DOWN:
+		if (entityPositionData[tileY + 1][tileX] == ENTITY_SKULL) {
+			swords.push_back(Entity(glm::vec3(position.x, position.y - MAP_TILE_SIZE, 1),
+				glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_SWORD, true));
+			swords[swords.size() - 1].sprite = SheetSprite(swordSprite, 0.5f, 0.0f, 0.25f, 1.0f, 0.10f);
+			return true;
+		}
+		break;
+	case DIRECTION_LEFT:
+		if (entityPositionData[tileY][tileX - 1] == ENTITY_SKULL) {
+			swords.push_back(Entity(glm::vec3(position.x - MAP_TILE_SIZE, position.y, 1),
+				glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_SWORD, true));
+			swords[swords.size() - 1].sprite = SheetSprite(swordSprite, 0.75f, 0.0f, 0.25f, 1.0f, 0.10f);
+			return true;
+		}
+		break;
+	case DIRECTION_RIGHT:
+		if (entityPositionData[tileY][tileX + 1] == ENTITY_SKULL) {
+			swords.push_back(Entity(glm::vec3(position.x + MAP_TILE_SIZE, position.y, 1),
+				glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_SWORD, true));
+			swords[swords.size() - 1].sprite = SheetSprite(swordSprite, 0.25f, 0.0f, 0.25f, 1.0f, 0.10f);
+			return true;
+		}
+		break;
+	}
+	return false;
+}
+
+void clearLevel() {
+	enemies.clear();
+	torches.clear();
+	keysVector.clear();
+	doors.clear();
+	swords.clear();
+}
+
+// steps the player, or uses a key or the sword on whatever is in the way
+void playerAction(Direction d) {
+	if (d == DIRECTION_LEFT) {
+		player.faceRight = false;
+	}
+	else if (d == DIRECTION_RIGHT) {
+		player.faceRight = true;
+	}
+
+	bool blocked = (d == DIRECTION_LEFT && player.leftBlocked) || (d == DIRECTION_RIGHT && player.rightBlocked)
+		|| (d == DIRECTION_UP && player.upBlocked) || (d == DIRECTION_DOWN && player.downBlocked);
+	if (!blocked) {
+		player.clearPositionData();
+		if (d == DIRECTION_LEFT) {
+			player.position.x -= MAP_TILE_SIZE;
+		}
+		else if (d == DIRECTION_RIGHT) {
+			player.position.x += MAP_TILE_SIZE;
+		}
+		else if (d == DIRECTION_UP) {
+			player.position.y += MAP_TILE_SIZE;
+		}
+		else if (d == DIRECTION_DOWN) {
+			player.position.y -= MAP_TILE_SIZE;
+		}
+		player.setPositionData();
+
+		resolveEnemyTurn();
+	}
+	else {
+		player.placeKey(d);
+		if (!player.attack(d)) {
+			gameEvents.hitWall = true;
+			resolveEnemyTurn();
+		}
+		else {
+			gameEvents.swordSwung = true;
+		}
+	}
+}
+
+// every animation frame skulls look for the player and swords get closer to landing
+void animationTick(float elapsed) {
+	updatePlayerView();
+	for (unsigned i = 0; i < enemies.size(); i++) {
+		enemies[i].Update(elapsed);
+	}
+	for (unsigned i = 0; i < swords.size(); i++) {
+		swords[i].timeRemaining--;
+	}
+}
+
+void resolveKeys() {
+	for (unsigned i = 0; i < keysVector.size(); i++) {
+		if (keysVector[i].collided(player)) {
+			gameEvents.keyPickedUp = true;
+			keysVector.erase(keysVector.begin() + i);
+			keyCount++;
+			i--;
+		}
+		else {
+			for (unsigned j = 0; j < doors.size(); j++) {
+				if (keysVector[i].collided(doors[j])) {
+					gameEvents.doorOpened = true;
+					keysVector.erase(keysVector.begin() + i);
+					doors[j].clearPositionData();
+					doors.erase(doors.begin() + j);
+					i--;
+					break;
+				}
+			}
+		}
+	}
+}
+
+// a landed sword kills the skull under it and then the skulls get their turn
+void resolveSwords() {
+	for (unsigned i = 0; i < swords.size(); i++) {
+		if (swords[i].timeRemaining == 0) {
+			for (unsigned j = 0; j < enemies.size(); j++) {
+				if (enemies[j].collided(swords[i])) {
+					enemies[j].clearPositionData();
+					enemies.erase(enemies.begin() + j);
+					swords.erase(swords.begin() + i);
+					i--;
+					break;
+				}
+			}
+
+			resolveEnemyTurn();
+		}
+	}
+}
+
+void checkLevelOutcome() {
+	for (Entity& enemy : enemies) {
+		if (enemy.collided(player)) {
+			state = STATE_GAMEOVER;
+			gameOverMessage = "You Died";
+		}
+	}
+
+	if (player.collided(exitLadder)) {
+		if (currentLevel == 3) {
+			state = STATE_GAMEOVER;
+			gameOverMessage = "That's all the Levels";
+		}
+		else {
+			state = STATE_NEXT_LEVEL;
+		}
+	}
+}
+
+// rows of the previous level, the map can be reloaded many times when running headless
+int levelDataHeight = 0;
+// the grid the levelData rows point into and the entities it started with
+LoadedLevel levelInPlay;
+
+void freeLevelData() {
+	for (int i = 0; i < levelDataHeight; ++i) {
+		delete[] entityPositionData[i];
+	}
+	if (levelDataHeight > 0) {
+		delete[] levelData;
+		delete[] entityPositionData;
+	}
+	levelDataHeight = 0;
+}
+
+// points the rows of levelData at a width * height grid
+void allocateLevelData(short *tiles) {
+	levelData = new short*[mapHeight];
+	entityPositionData = new EntityType*[mapHeight];
+	for (int i = 0; i < mapHeight; ++i) {
+		levelData[i] = tiles + i * mapWidth;
+		entityPositionData[i] = new EntityType[mapWidth]();
+	}
+	levelDataHeight = mapHeight;
+}
+
+bool readHeader(std::istream &stream, LoadedLevel &level) {
+	string line;
+	int width = -1;
+	int height = -1;
+	while (getline(stream, line)) {
+		if (line == "") { break; }
+
+		istringstream sStream(line);
+		string key, value;
+		getline(sStream, key, '=');
+		getline(sStream, value);
+
+		if (key == "width") {
+			width = atoi(value.c_str());
+		}
+		else if (key == "height") {
+			height = atoi(value.c_str());
+		}
+	}
+
+	if (width <= 0 || height <= 0) {
+		return false;
+	}
+	else { // allocate our map data
+		level.width = width;
+		level.height = height;
+		level.tileStorage.assign(width * height, 0);
+		return true;
+	}
+}
+
+bool readLayerData(std::istream &stream, LoadedLevel &level) {
+	string line;
+	while (getline(stream, line)) {
+		if (line == "") { break; }
+		istringstream sStream(line);
+		string key, value;
+		getline(sStream, key, '=');
+		getline(sStream, value);
+		if (key == "data") {
+			for (int y = 0; y < level.height; y++) {
+				getline(stream, line);
+				istringstream lineStream(line);
+				string tile;
+
+				for (int x = 0; x < level.width; x++) {
+					getline(lineStream, tile, ',');
+					unsigned char val = (unsigned char)atoi(tile.c_str());
+					if (val > 0) {
+						// be careful, the tiles in this format are indexed from 1 not 0
+						level.tileStorage[y * level.width + x] = val - 1;
+					}
+					else {
+						level.tileStorage[y * level.width + x] = 0;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// the type names of the Tiled export, indexed by EntityType
+const char *entityTypeNames[] = { "", "Player", "Skull", "Torch", "Side_Torch", "Door", "Key", "Exit" };
+const int ENTITY_TYPE_NAME_COUNT = sizeof(entityTypeNames) / sizeof(entityTypeNames[0]);
+
+EntityType entityTypeFromName(const string& type) {
+	for (int i = 1; i < ENTITY_TYPE_NAME_COUNT; i++) {
+		if (type == entityTypeNames[i]) {
+			return (EntityType)i;
+		}
+	}
+	return ENTITY_NONE;
+}
+
+EntityType entityTypeFromName(const MapToken& type) {
+	for (int i = 1; i < ENTITY_TYPE_NAME_COUNT; i++) {
+		if (type.Is(entityTypeNames[i])) {
+			return (EntityType)i;
+		}
+	}
+	return ENTITY_NONE;
+}
+
+void placeEntity(const LevelFileEntity& entity) {
+	float x = entity.x*MAP_TILE_SIZE + MAP_TILE_SIZE / 2;
+	float y = entity.y*-MAP_TILE_SIZE + MAP_TILE_SIZE / 2;
+	EntityType type = (EntityType)entity.type;
+
+	if (type == ENTITY_PLAYER) {
+		player = Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), false, ENTITY_PLAYER, true);
+		player.sprite = SheetSprite(playerSpriteSheet, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f, 4);
+	}
+	else if (type == ENTITY_SKULL) {
+		enemies.push_back(Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), false, ENTITY_SKULL, false));
+		enemies[enemies.size() - 1].sprite = SheetSprite(skullSpriteSheet, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f, 4);
+		enemies[enemies.size() - 1].id = enemies.size() - 1;
+	}
+	else if (type == ENTITY_TORCH) {
+		torches.push_back(Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_TORCH, true));
+		torches[torches.size() - 1].sprite = SheetSprite(torchSpriteSheet, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f, 4);
+	}
+	else if (type == ENTITY_SIDE_TORCH) {
+		torches.push_back(Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_SIDE_TORCH, true));
+		torches[torches.size() - 1].sprite = SheetSprite(sideTorchSpriteSheet, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f, 4);
+	}
+	else if (type == ENTITY_KEY) {
+		keysVector.push_back(Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_KEY, true));
+		keysVector[keysVector.size() - 1].sprite = SheetSprite(keySpriteSheet, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f, 4);
+	}
+	else if (type == ENTITY_DOOR) {
+		doors.push_back(Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_DOOR, true));
+		doors[doors.size() - 1].sprite = SheetSprite(mapSpriteSheet, 0.6f, 0.4f, 0.1f, 0.1f, 0.10f);
+	}
+	else if (type == ENTITY_EXIT) {
+		exitLadder = Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_EXIT, true);
+		exitLadder.sprite = SheetSprite(mapSpriteSheet, 0.9f, 0.3f, 0.1f, 0.1f, 0.10f);
+	}
+
+	int tileX, tileY;
+	worldToTileCoordinates(x, y, tileX, tileY);
+	if (type == ENTITY_PLAYER || type == ENTITY_SKULL || type == ENTITY_DOOR) {
+		entityPositionData[tileY][tileX] = type;
+	}
+}
+
+bool readEntityData(std::istream &stream, LoadedLevel &level) {
+	string line;
+	EntityType type = ENTITY_NONE;
+
+	while (getline(stream, line)) {
+		if (line == "") { break; }
+
+		istringstream sStream(line);
+		string key, value;
+		getline(sStream, key, '=');
+		getline(sStream, value);
+
+		if (key == "type") {
+			type = entityTypeFromName(value);
+		}
+		else if (key == "location") {
+			istringstream lineStream(value);
+			string xPosition, yPosition;
+			getline(lineStream, xPosition, ',');
+			getline(lineStream, yPosition, ',');
+
+			LevelFileEntity entity;
+			entity.type = type;
+			entity.x = atoi(xPosition.c_str());
+			entity.y = atoi(yPosition.c_str());
+			// entity rows are one lower than the layer
+			if (entity.x < 0 || entity.x >= level.width || entity.y < 1 || entity.y > level.height) {
+				return false;
+			}
+			level.entities.push_back(entity);
+		}
+	}
+	return true;
+}
+
+// a compiled level used in place, false when it is missing, damaged or does not match this build
+bool readLevelFile(const string& fileName, LoadedLevel& level) {
+	level.Clear();
+	if (!level.file.Open(fileName)) {
+		return false;
+	}
+	int width = level.file.header->width;
+	int height = level.file.header->height;
+
+	// the same places and types the text export can hold, entity rows are one lower than the layer
+	for (uint32_t i = 0; i < level.file.header->entityCount; i++) {
+		const LevelFileEntity& entity = level.file.entities[i];
+		if (entity.x < 0 || entity.x >= width || entity.y < 1 || entity.y > height
+			|| entity.type < ENTITY_PLAYER || entity.type > ENTITY_SWORD) {
+			level.file.Close();
+			return false;
+		}
+	}
+
+	level.width = width;
+	level.height = height;
+	level.entities.assign(level.file.entities, level.file.entities + level.file.header->entityCount);
+	return true;
+}
+
+// level1.txt compiles to level1.lvl
+string compiledLevelName(const string& mapFile) {
+	size_t extension = mapFile.find_last_of('.');
+	return mapFile.substr(0, extension) + ".lvl";
+}
+
+void finishScene(const string& name);
+
+bool readLevel(const string& mapFile, LoadedLevel& level, string& error) {
+	string compiledFile = compiledLevelName(mapFile);
+	if (fileIsCurrent(compiledFile, mapFile) && readLevelFile(compiledFile, level)) {
+		return true;
+	}
+
+	MappedFile file;
+	if (!file.Open(mapFile)) {
+		error = "Unable to open " + mapFile;
+		return false;
+	}
+	if (!readLevel((const char*)file.data, file.size, level, error)) {
+		error = mapFile + ":" + error;
+		return false;
+	}
+	return true;
+}
+
+// the structures of a level that take longest to build
+class LevelStructures {
+public:
+	PassabilityGrid passability;
+	SearchContext searchContext;
+	HierarchicalPlanner hierarchicalPlanner;
+};
+
+void prepareLevel(LoadedLevel& level) {
+	int skullCount = 0;
+	for (const LevelFileEntity& entity : level.entities) {
+		skullCount += entity.type == ENTITY_SKULL;
+	}
+	level.structures = make_shared<LevelStructures>();
+	LevelStructures& structures = *level.structures;
+	structures.passability.Build(level);
+	structures.searchContext.Resize(level.width, level.height);
+	structures.hierarchicalPlanner.Build(structures.passability, level.width, level.height, skullCount);
+}
+
+void installLevel(LoadedLevel& level, const string& name) {
+	if (!level.structures) {
+		prepareLevel(level);
+	}
+	freeLevelData();
+	levelInPlay.Swap(level);
+	level.Clear();
+
+	mapWidth = levelInPlay.width;
+	mapHeight = levelInPlay.height;
+	allocateLevelData(levelInPlay.Tiles());
+	clearLevel();
+	for (unsigned i = 0; i < levelInPlay.entities.size(); i++) {
+		placeEntity(levelInPlay.entities[i]);
+	}
+	finishScene(name);
+}
+
+bool setupScene(const string& mapFile) {
+	LoadedLevel level;
+	string error;
+	if (!readLevel(mapFile, level, error)) {
+		std::cout << error << "\n";
+		return false;
+	}
+	installLevel(level, mapFile);
+	return true;
+}
+
+bool setupScene(istream& stream, const string& name) {
+	LoadedLevel level;
+	if (!readLevel(stream, level)) {
+		return false;
+	}
+	installLevel(level, name);
+	return true;
+}
+
+bool setupScene(const char *text, size_t size, const string& name, string& error) {
+	LoadedLevel level;
+	if (!readLevel(text, size, level, error)) {
+		return false;
+	}
+	installLevel(level, name);
+	return true;
+}
+
+bool readLevel(istream& stream, LoadedLevel& level) {
+	level.Clear();
+	bool headerRead = false;
+	string line;
+	while (getline(stream, line)) {
+		if (line == "[header]") {
+			if (!readHeader(stream, level))
+				return false;
+			headerRead = true;
+		}
+		else if (line == "[layer]") {
+			readLayerData(stream, level);
+		}
+		else if (line == "[Entity]") {
+			if (!readEntityData(stream, level))
+				return false;
+		}
+	}
+	return headerRead;
+}
+
+bool readHeader(MapTokenizer &tokenizer, const MapToken &section, LoadedLevel &level) {
+	MapToken key, value;
+	int width = -1;
+	int height = -1;
+	while (tokenizer.NextProperty(key, value)) {
+		const char *cursor = value.start;
+		if (key.Is("width") && !tokenizer.ReadNumber(cursor, value.end, width)) {
+			return false;
+		}
+		else if (key.Is("height") && !tokenizer.ReadNumber(cursor, value.end, height)) {
+			return false;
+		}
+	}
+	if (width <= 0 || height <= 0) {
+		return tokenizer.Fail(section.start - 1, "the header needs a width and a height");
+	}
+
+	level.width = width;
+	level.height = height;
+	level.tileStorage.assign(width * height, 0);
+	return true;
+}
+
+bool readLayerData(MapTokenizer &tokenizer, LoadedLevel &level, bool headerRead) {
+	MapToken key, value;
+	while (tokenizer.NextProperty(key, value)) {
+		if (!key.Is("data")) {
+			continue;
+		}
+		if (!headerRead) {
+			return tokenizer.Fail(key.start, "the layer comes before the header");
+		}
+		short *tiles = level.tileStorage.data();
+		for (int i = 0; i < level.width * level.height; i++) {
+			int tile;
+			if (!tokenizer.ReadTile(tile)) {
+				return false;
+			}
+			// be careful, the tiles in this format are indexed from 1 not 0
+			unsigned char val = (unsigned char)tile;
+			tiles[i] = val > 0 ? val - 1 : 0;
+		}
+	}
+	return true;
+}
+
+bool readEntityData(MapTokenizer &tokenizer, LoadedLevel &level, bool headerRead) {
+	MapToken key, value;
+	EntityType type = ENTITY_NONE;
+	while (tokenizer.NextProperty(key, value)) {
+		if (key.Is("type")) {
+			type = entityTypeFromName(value);
+		}
+		else if (key.Is("location")) {
+			LevelFileEntity entity;
+			entity.type = type;
+			const char *cursor = value.start;
+			if (!tokenizer.ReadNumber(cursor, value.end, entity.x) || !tokenizer.ReadNumber(cursor, value.end, entity.y)) {
+				return false;
+			}
+			if (!headerRead) {
+				return tokenizer.Fail(key.start, "the entity comes before the header");
+			}
+			// entity rows are one lower than the layer
+			if (entity.x < 0 || entity.x >= level.width || entity.y < 1 || entity.y > level.height) {
+				return tokenizer.Fail(value.start, "the entity is outside the map");
+			}
+			level.entities.push_back(entity);
+		}
+	}
+	return true;
+}
+
+// the same format readHeader, readLayerData and readEntityData read from a stream, in one
+// pass over the text. error is line:column: message when it returns false
+bool readLevel(const char *text, size_t size, LoadedLevel& level, string& error) {
+	level.Clear();
+	MapTokenizer tokenizer(text, size);
+	MapToken section;
+	bool read = true;
+	bool headerRead = false;
+	while (read && tokenizer.NextSection(section)) {
+		if (section.Is("header")) {
+			read = readHeader(tokenizer, section, level);
+			headerRead = read;
+		}
+		else if (section.Is("layer")) {
+			read = readLayerData(tokenizer, level, headerRead);
+		}
+		else if (section.Is("Entity")) {
+			read = readEntityData(tokenizer, level, headerRead);
+		}
+	}
+	if (read && !headerRead) {
+		read = tokenizer.Fail(text, "missing [header]");
+	}
+	if (!read) {
+		error = to_string(tokenizer.errorLine) + ":" + to_string(tokenizer.errorColumn) + ": " + tokenizer.error;
+	}
+	return read;
+}
+
+// everything built from the loaded grid, the same for text and compiled levels
+void finishScene(const string& name) {
+	// mix the file name in so every level wanders differently
+	levelSeed = 2166136261u ^ gameSeed;
+	for (unsigned i = 0; i < name.size(); i++) {
+		levelSeed = (levelSeed ^ (unsigned char)name[i]) * 16777619u;
+	}
+	turnNumber = 0;
+
+	// built by prepareLevel, the old ones go with levelInPlay.structures
+	LevelStructures& structures = *levelInPlay.structures;
+	swap(passability, structures.passability);
+	swap(searchContext, structures.searchContext);
+	// the hierarchy scratch only grows during turns, so the one already grown stays
+	swap(searchContext.hierarchy, structures.searchContext.hierarchy);
+	swap(hierarchicalPlanner, structures.hierarchicalPlanner);
+	levelInPlay.structures.reset();
+	resizePlayerDistanceField();
+	incrementalPlanner.Reset(enemies.size());
+	playerView.Resize(mapWidth, mapHeight);
+	invalidatePlayerView();
+	resizeEnemyTurn();
+}
+
+bool compileLevel(const char *text, size_t size, const string& name, const string& outputFile, string& error) {
+	LoadedLevel level;
+	if (!readLevel(text, size, level, error)) {
+		return false;
+	}
+	vector<short*> rows(level.height);
+	for (int y = 0; y < level.height; y++) {
+		rows[y] = level.Tiles() + y * level.width;
+	}
+	if (!writeLevelFile(outputFile, level.width, level.height, rows.data(), level.entities.data(), (uint32_t)level.entities.size())) {
+		error = "could not write " + outputFile;
+		return false;
+	}
+	return true;
+}
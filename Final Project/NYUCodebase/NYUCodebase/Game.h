@@ -0,0 +1,228 @@
+#pragma once
+
+// everything that decides how the game plays, with no SDL video or GL in sight
+// so the same turns can run in the window or in the headless benchmark
+
+#include "glm/mat4x4.hpp"
+#include "LevelFile.h"
+#include <vector>
+#include <string>
+#include <istream>
+#include <cstdint>
+#include <utility>
+#include <memory>
+
+#define MAP_TILE_SIZE 0.1f
+#define CLUSTER_SIZE 10
+#define SIGHT_RADIUS 2
+#define PARALLEL_ENEMY_THRESHOLD 256
+
+enum GameState { STATE_TITLE, STATE_GAME, STATE_GAMEOVER, STATE_NEXT_LEVEL };
+enum EntityType { ENTITY_NONE, ENTITY_PLAYER, ENTITY_SKULL, ENTITY_TORCH, ENTITY_SIDE_TORCH, ENTITY_DOOR, ENTITY_KEY, ENTITY_EXIT, ENTITY_SWORD };
+enum EntityState { ENTITY_IDLE, ENTITY_CHASE };
+enum Direction { DIRECTION_NONE, DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT };
+enum PathMode { PATH_ASTAR, PATH_JPS, PATH_FLOW_FIELD, PATH_INCREMENTAL, PATH_HIERARCHICAL };
+
+class SearchContext;
+
+// only the texture id and frame are kept here, the renderer batches the sprites
+// animated sprites lay their frames out left to right from u, the renderer picks the frame from
+// the animation clock so nothing here changes while they play
+class SheetSprite {
+public:
+	SheetSprite() {}
+	SheetSprite(unsigned int textureID, float u, float v, float width, float height, float size, int frameCount = 1) {
+		this->textureID = textureID;
+		this->u = u;
+		this->v = v;
+		this->width = width;
+		this->height = height;
+		this->size = size;
+		this->frameCount = frameCount;
+	}
+
+	// the frame showing at a time, the instanced vertex shader does the same sum
+	int Frame(float animationTime, float framesPerSecond) const {
+		if (frameCount <= 1) {
+			return 0;
+		}
+		return (int)(animationTime * framesPerSecond + phase) % frameCount;
+	}
+
+	float size;
+	unsigned int textureID;
+	float u;
+	float v;
+	float width;
+	float height;
+
+	int frameCount = 1;
+	float phase = 0.0f; // in frames, lets sprites of one sheet play out of step
+};
+
+class Entity {
+public:
+	Entity() {}
+	Entity(glm::vec3 position, glm::vec3 size, bool isStatic, EntityType type, bool faceRight) {
+		this->position = position;
+		this->size = size;
+		this->isStatic = isStatic;
+		this->entityType = type;
+		this->faceRight = faceRight;
+	}
+
+	void Update(float elapsed);
+
+	void clearPositionData();
+	void setPositionData();
+
+	// basic movement AI for non static enemy only
+	Direction ProposeMove(int playerTileX, int playerTileY, SearchContext& context) const;
+	uint32_t TurnRandom() const;
+	void ApplyMove(Direction next);
+
+	bool placeKey(Direction d);
+	bool attack(Direction d);
+
+	bool collided(Entity& other);
+
+	SheetSprite sprite;
+
+	glm::vec3 position;
+	glm::vec3 size;
+
+	bool isStatic;
+	EntityType entityType;
+
+	bool faceRight;
+
+	bool leftBlocked = false;
+	bool rightBlocked = false;
+	bool upBlocked = false;
+	bool downBlocked = false;
+
+	int timeRemaining = 2; // for sword entity only
+	uint32_t id = 0; // skulls keep it when others die, it keys their random numbers
+
+	EntityState currentState = ENTITY_IDLE;
+};
+
+// what happened since the renderer last looked, so it can play the sounds
+struct GameEvents {
+	bool hitWall = false;
+	bool swordSwung = false;
+	bool keyPickedUp = false;
+	bool doorOpened = false;
+};
+
+// the passability, search and hierarchy structures built from a level, see prepareLevel
+class LevelStructures;
+
+// a level read from its file but not in play, reading one never touches the level being played
+// so a file that fails to load leaves the game as it was
+class LoadedLevel {
+public:
+	short *Tiles() {
+		return file.tiles != NULL ? file.tiles : tileStorage.data();
+	}
+
+	const short *Tiles() const {
+		return file.tiles != NULL ? file.tiles : tileStorage.data();
+	}
+
+	void Swap(LoadedLevel& other) {
+		std::swap(width, other.width);
+		std::swap(height, other.height);
+		tileStorage.swap(other.tileStorage);
+		file.Swap(other.file);
+		entities.swap(other.entities);
+		structures.swap(other.structures);
+	}
+
+	void Clear() {
+		width = 0;
+		height = 0;
+		tileStorage.clear();
+		file.Close();
+		entities.clear();
+		structures.reset();
+	}
+
+	int width = 0;
+	int height = 0;
+	std::vector<short> tileStorage; // the grid of a text level
+	LevelFile file; // a compiled level is used in place, its tiles are the grid then
+	std::vector<LevelFileEntity> entities; // in file order, which is what a compiled level stores
+	std::shared_ptr<LevelStructures> structures; // empty until prepareLevel
+};
+
+extern GameState state;
+extern PathMode pathMode;
+extern GameEvents gameEvents;
+
+extern uint32_t gameSeed;
+extern uint32_t levelSeed;
+extern uint32_t turnNumber;
+
+extern int mapWidth;
+extern int mapHeight;
+extern short **levelData;
+extern EntityType **entityPositionData;
+
+// atlas handles filled in by the renderer, stay 0 when running headless
+extern unsigned int playerSpriteSheet;
+extern unsigned int skullSpriteSheet;
+extern unsigned int torchSpriteSheet;
+extern unsigned int sideTorchSpriteSheet;
+extern unsigned int keySpriteSheet;
+extern unsigned int mapSpriteSheet;
+extern unsigned int swordSprite;
+
+extern std::string gameOverMessage;
+extern int currentLevel;
+extern int keyCount;
+
+extern Entity player;
+extern std::vector<Entity> enemies;
+extern std::vector<Entity> torches;
+extern std::vector<Entity> keysVector;
+extern std::vector<Entity> doors;
+extern Entity exitLadder;
+extern std::vector<Entity> swords;
+
+// astar, jps, flow, incremental or hierarchical, false for anything else
+bool pathModeFromName(const std::string& name, PathMode& mode);
+void worldToTileCoordinates(float worldX, float worldY, int& gridX, int& gridY);
+bool isSolid(int tileIndex);
+uint32_t philox(uint32_t counterHigh, uint32_t counterLow, uint32_t key);
+
+void clearLevel();
+// false when the level can't be read, the level in play is left untouched then
+bool setupScene(const std::string& mapFile);
+bool setupScene(std::istream& stream, const std::string& name);
+// error is line:column: message when the text does not parse
+bool setupScene(const char *text, size_t size, const std::string& name, std::string& error);
+// parses a text level and writes it as a compiled level, which setupScene prefers from then on
+bool compileLevel(const char *text, size_t size, const std::string& name, const std::string& outputFile, std::string& error);
+// the compiled level when it is current and the text otherwise, error says why when neither reads
+// nothing but level is touched, so it can run on a loading thread
+bool readLevel(const std::string& mapFile, LoadedLevel& level, std::string& error);
+// builds the structures of level that take longest, on the level alone so a loading thread can
+// do it and installLevel only swaps them in
+void prepareLevel(LoadedLevel& level);
+// puts a level from readLevel in play and builds everything else from it, level is left empty
+void installLevel(LoadedLevel& level, const std::string& name);
+// the level without putting it in play, the stream one is the old line by line reader and the
+// other one is the single pass tokenizer setupScene uses
+bool readLevel(std::istream& stream, LoadedLevel& level);
+bool readLevel(const char *text, size_t size, LoadedLevel& level, std::string& error);
+
+// one turn of the game, called in this order by both the window and the headless runner
+void playerAction(Direction d);
+void animationTick(float elapsed);
+void resolveKeys();
+void resolveSwords();
+void checkLevelOutcome();
+
+void updatePlayerView();
+void resolveEnemyTurn();
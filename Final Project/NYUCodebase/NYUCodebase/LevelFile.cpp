@@ -0,0 +1,81 @@
+
+#include "LevelFile.h"
+#include <stdio.h>
+#include <vector>
+#include <utility>
+
+LevelFile::LevelFile() : header(NULL), tiles(NULL), entities(NULL) {}
+
+LevelFile::~LevelFile() {
+	Close();
+}
+
+bool LevelFile::Open(const std::string &fileName) {
+	Close();
+	if (!file.Open(fileName) || file.size < sizeof(LevelFileHeader)) {
+		Close();
+		return false;
+	}
+
+	// everything the offsets point at has to be inside the file
+	header = (const LevelFileHeader*)file.data;
+	uint64_t tileBytes = (uint64_t)header->width * header->height * sizeof(short);
+	uint64_t entityBytes = (uint64_t)header->entityCount * sizeof(LevelFileEntity);
+	bool valid = header->magic == LEVEL_FILE_MAGIC && header->version == LEVEL_FILE_VERSION
+		&& header->fileSize == file.size && header->width > 0 && header->height > 0
+		&& header->tileOffset % sizeof(short) == 0 && header->entityOffset % sizeof(int32_t) == 0
+		&& header->tileOffset + tileBytes <= file.size && header->entityOffset + entityBytes <= file.size;
+	if (!valid) {
+		Close();
+		return false;
+	}
+
+	tiles = (short*)((char*)file.data + header->tileOffset);
+	entities = (const LevelFileEntity*)((char*)file.data + header->entityOffset);
+	return true;
+}
+
+void LevelFile::Close() {
+	file.Close();
+	header = NULL;
+	tiles = NULL;
+	entities = NULL;
+}
+
+void LevelFile::Swap(LevelFile &other) {
+	file.Swap(other.file);
+	std::swap(header, other.header);
+	std::swap(tiles, other.tiles);
+	std::swap(entities, other.entities);
+}
+
+bool writeLevelFile(const std::string &fileName, int width, int height, short **tiles,
+	const LevelFileEntity *entities, uint32_t entityCount) {
+	LevelFileHeader header;
+	header.magic = LEVEL_FILE_MAGIC;
+	header.version = LEVEL_FILE_VERSION;
+	header.width = width;
+	header.height = height;
+	header.tileOffset = sizeof(LevelFileHeader);
+	// the entity table starts on a 4 byte boundary after the tiles
+	header.entityOffset = (header.tileOffset + width * height * sizeof(short) + 3) & ~3u;
+	header.entityCount = entityCount;
+	header.fileSize = header.entityOffset + entityCount * sizeof(LevelFileEntity);
+
+	FILE *file = fopen(fileName.c_str(), "wb");
+	if (file == NULL) {
+		return false;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (int y = 0; y < height && written; y++) {
+		written = fwrite(tiles[y], sizeof(short), width, file) == (size_t)width;
+	}
+	std::vector<char> padding(header.entityOffset - header.tileOffset - width * height * sizeof(short), 0);
+	if (written && !padding.empty()) {
+		written = fwrite(padding.data(), 1, padding.size(), file) == padding.size();
+	}
+	if (written && entityCount > 0) {
+		written = fwrite(entities, sizeof(LevelFileEntity), entityCount, file) == entityCount;
+	}
+	return fclose(file) == 0 && written;
+}
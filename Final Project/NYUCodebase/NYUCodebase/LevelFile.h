@@ -0,0 +1,54 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <stdint.h>
+#include <string>
+
+// "LEVL" when read as bytes
+#define LEVEL_FILE_MAGIC 0x4C56454C
+#define LEVEL_FILE_VERSION 1
+
+// a level compiled from the Tiled text export, laid out so the mapped file is used as is
+// the header is followed by width * height tiles row by row, already indexed from 0, and then
+// the entity table. offsets are from the start of the file
+struct LevelFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+	uint32_t tileOffset;
+	uint32_t entityOffset;
+	uint32_t entityCount;
+	uint32_t fileSize;
+};
+
+// one [Entity] section, x and y are the tile location as Tiled writes it, one row below the layer
+struct LevelFileEntity {
+	int32_t type; // an EntityType
+	int32_t x;
+	int32_t y;
+};
+
+// a view of a mapped compiled level, the tiles are copy on write so they can back levelData
+class LevelFile {
+	public:
+		LevelFile();
+		~LevelFile();
+
+		// false when the file is missing, truncated or from another version
+		bool Open(const std::string &fileName);
+		void Close();
+		// trades files, the tiles and entities keep pointing at the same memory
+		void Swap(LevelFile &other);
+
+		const LevelFileHeader *header;
+		short *tiles;
+		const LevelFileEntity *entities;
+
+	private:
+		MappedFile file;
+};
+
+// tiles are rows of width shorts, the result is false when the file could not be written
+bool writeLevelFile(const std::string &fileName, int width, int height, short **tiles,
+	const LevelFileEntity *entities, uint32_t entityCount);
@@ -0,0 +1,68 @@
+
+#include "LevelPreloader.h"
+#include "Game.h"
+#include <SDL.h>
+
+LevelPreloader::LevelPreloader() : pending(false), ready(false), loaded(false), mesh(NULL) {}
+
+LevelPreloader::~LevelPreloader() {
+	Cancel();
+}
+
+void LevelPreloader::Start(const std::string &mapFile, TileMapMesh &mesh, int spriteCountX, int spriteCountY, float tileSize, const AtlasRegion &region) {
+	Cancel();
+	this->mesh = &mesh;
+	this->mapFile = mapFile;
+	ready = false;
+	pending = true;
+	worker = std::thread(&LevelPreloader::Load, this, mapFile, spriteCountX, spriteCountY, tileSize, region);
+}
+
+void LevelPreloader::Load(std::string mapFile, int spriteCountX, int spriteCountY, float tileSize, AtlasRegion region) {
+	std::string error;
+	loaded = readLevel(mapFile, level, error);
+	if (loaded) {
+		prepareLevel(level);
+		std::vector<short*> rows(level.height);
+		for (int y = 0; y < level.height; y++) {
+			rows[y] = level.Tiles() + y * level.width;
+		}
+		mesh->Prepare(rows.data(), level.width, level.height, spriteCountX, spriteCountY, tileSize, region);
+	}
+	else {
+		SDL_Log("%s", error.c_str());
+	}
+	ready = true;
+
+	// the main loop may be asleep in SDL_WaitEventTimeout
+	SDL_Event event;
+	SDL_memset(&event, 0, sizeof(event));
+	event.type = SDL_USEREVENT;
+	SDL_PushEvent(&event);
+}
+
+bool LevelPreloader::Ready() const {
+	return ready;
+}
+
+bool LevelPreloader::Finish() {
+	if (!pending) {
+		return false;
+	}
+	worker.join();
+	pending = false;
+	if (!loaded) {
+		return false;
+	}
+	installLevel(level, mapFile);
+	mesh->Upload();
+	return true;
+}
+
+void LevelPreloader::Cancel() {
+	if (worker.joinable()) {
+		worker.join();
+	}
+	level.Clear();
+	pending = false;
+}
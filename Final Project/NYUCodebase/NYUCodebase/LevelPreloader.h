@@ -0,0 +1,38 @@
+#pragma once
+
+#include "TileMapMesh.h"
+#include "Game.h"
+#include <string>
+#include <thread>
+#include <atomic>
+
+// reads the next level on a worker thread while the level complete screen is up
+// the worker only fills its own LoadedLevel, with the structures prepareLevel builds, and the
+// mesh. Finish swaps the level in on the calling thread, the mesh must not be drawn until then
+class LevelPreloader {
+	public:
+		LevelPreloader();
+		~LevelPreloader();
+
+		// reads mapFile aside and prepares it and mesh
+		void Start(const std::string &mapFile, TileMapMesh &mesh, int spriteCountX, int spriteCountY, float tileSize, const AtlasRegion &region);
+		// true once the worker is done, it also pushes an SDL_USEREVENT to wake the main loop
+		bool Ready() const;
+		// waits for the worker if it is still going, puts the level in play and uploads the mesh
+		// false when the level could not be read, the previous one is still in place then
+		bool Finish();
+		// waits for the worker and throws its work away, for when the player leaves instead
+		void Cancel();
+
+		bool pending;
+
+	private:
+		void Load(std::string mapFile, int spriteCountX, int spriteCountY, float tileSize, AtlasRegion region);
+
+		std::thread worker;
+		std::atomic<bool> ready;
+		LoadedLevel level;
+		std::string mapFile;
+		bool loaded;
+		TileMapMesh *mesh;
+};
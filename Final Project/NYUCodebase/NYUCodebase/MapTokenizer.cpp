@@ -0,0 +1,162 @@
+
+#include "MapTokenizer.h"
+#include <string.h>
+
+bool MapToken::Is(const char *text) const {
+	size_t length = strlen(text);
+	return (size_t)(end - start) == length && memcmp(start, text, length) == 0;
+}
+
+MapTokenizer::MapTokenizer(const char *text, size_t size) : error(NULL), errorLine(0), errorColumn(0),
+	begin(text), cursor(text), end(text + size), lineStart(text), line(1) {}
+
+bool MapTokenizer::NextLine(MapToken &result) {
+	// whatever ReadTile left of its last line is not part of the next one
+	if (cursor != lineStart) {
+		while (cursor < end && *cursor != '\n') {
+			cursor++;
+		}
+		if (cursor < end) {
+			cursor++;
+			line++;
+			lineStart = cursor;
+		}
+	}
+	if (cursor >= end) {
+		return false;
+	}
+
+	const char *lineEnd = (const char*)memchr(cursor, '\n', end - cursor);
+	result.start = cursor;
+	result.end = lineEnd != NULL ? lineEnd : end;
+	if (result.end > result.start && result.end[-1] == '\r') {
+		result.end--;
+	}
+	if (lineEnd != NULL) {
+		cursor = lineEnd + 1;
+		line++;
+	}
+	else {
+		cursor = end;
+	}
+	lineStart = cursor;
+	return true;
+}
+
+bool MapTokenizer::NextSection(MapToken &name) {
+	MapToken text;
+	while (NextLine(text)) {
+		if (text.end - text.start >= 2 && text.start[0] == '[' && text.end[-1] == ']') {
+			name.start = text.start + 1;
+			name.end = text.end - 1;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool MapTokenizer::NextProperty(MapToken &key, MapToken &value) {
+	// a section header ends the section too, it is left for NextSection
+	if (cursor == lineStart && cursor < end && *cursor == '[') {
+		return false;
+	}
+	MapToken text;
+	if (!NextLine(text) || text.start == text.end) {
+		return false;
+	}
+
+	const char *equals = (const char*)memchr(text.start, '=', text.end - text.start);
+	key.start = text.start;
+	key.end = equals != NULL ? equals : text.end;
+	value.start = equals != NULL ? equals + 1 : text.end;
+	value.end = text.end;
+	return true;
+}
+
+bool MapTokenizer::ReadTile(int &value) {
+	// rows of the layer are split by line ends, which count as spaces here
+	while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == '\n')) {
+		if (*cursor == '\n') {
+			line++;
+			lineStart = cursor + 1;
+		}
+		cursor++;
+	}
+	if (!ParseNumber(cursor, end, value)) {
+		return false;
+	}
+	if (cursor < end && *cursor == ',') {
+		cursor++;
+		return true;
+	}
+
+	// only the last number of a row can go without its comma
+	const char *after = cursor;
+	while (after < end && (*after == ' ' || *after == '\t')) {
+		after++;
+	}
+	if (after < end && *after != '\r' && *after != '\n') {
+		return Fail(cursor, "expected a comma");
+	}
+	return true;
+}
+
+bool MapTokenizer::ReadNumber(const char *&at, const char *stop, int &value) {
+	while (at < stop && *at == ' ') {
+		at++;
+	}
+	if (!ParseNumber(at, stop, value)) {
+		return false;
+	}
+	if (at < stop && *at == ',') {
+		at++;
+	}
+	else if (at < stop) {
+		return Fail(at, "expected a comma");
+	}
+	return true;
+}
+
+bool MapTokenizer::ParseNumber(const char *&at, const char *stop, int &value) {
+	bool negative = at < stop && *at == '-';
+	if (negative) {
+		at++;
+	}
+	if (at == stop || *at < '0' || *at > '9') {
+		return Fail(at, "expected a number");
+	}
+
+	// nine digits always fit in an int, no map needs more
+	const char *first = at;
+	int result = 0;
+	while (at < stop && *at >= '0' && *at <= '9') {
+		if (at - first == 9) {
+			return Fail(first, "number is too long");
+		}
+		result = result * 10 + (*at - '0');
+		at++;
+	}
+	value = negative ? -result : result;
+	return true;
+}
+
+bool MapTokenizer::Fail(const char *at, const char *message) {
+	if (error != NULL) {
+		return false;
+	}
+	error = message;
+
+	// at can be on a line the cursor has already left, count the line ends back to it
+	errorLine = line;
+	for (const char *c = at; c < lineStart; c++) {
+		if (*c == '\n') {
+			errorLine--;
+		}
+	}
+	const char *columnStart = at;
+	while (columnStart > begin && columnStart[-1] != '\n') {
+		columnStart--;
+	}
+	errorColumn = (int)(at - columnStart) + 1;
+	return false;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+
+// a piece of the text being tokenized, it points into the caller's buffer
+struct MapToken {
+	const char *start;
+	const char *end;
+
+	bool Is(const char *text) const;
+};
+
+// reads the Tiled text export ([header], [layer] and [Entity] sections of key=value lines)
+// in one pass over a buffer, without copying or allocating anything
+class MapTokenizer {
+	public:
+		MapTokenizer(const char *text, size_t size);
+
+		// skips to the next [name] line, false at the end of the text
+		bool NextSection(MapToken &name);
+		// the next key=value line of the section, false at the blank line or section that ends it
+		bool NextProperty(MapToken &key, MapToken &value);
+		// the next number of a comma separated run that may go over many lines, like the layer data
+		bool ReadTile(int &value);
+		// the next number of a comma separated value, cursor moves past it and its comma
+		bool ReadNumber(const char *&cursor, const char *end, int &value);
+
+		// records what went wrong at a place in the text and returns false
+		bool Fail(const char *at, const char *message);
+
+		// set by the first failure, lines and columns count from 1
+		const char *error;
+		int errorLine;
+		int errorColumn;
+
+	private:
+		// the current line without its line end, the cursor is left at the start of the next one
+		bool NextLine(MapToken &line);
+		bool ParseNumber(const char *&cursor, const char *end, int &value);
+
+		const char *begin;
+		const char *cursor;
+		const char *end;
+		const char *lineStart;
+		int line;
+};
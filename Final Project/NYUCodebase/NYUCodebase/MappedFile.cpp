@@ -0,0 +1,107 @@
+
+#include "MappedFile.h"
+#include <sys/stat.h>
+#include <utility>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : data(NULL), size(0)
+#ifdef _WIN32
+	, file(INVALID_HANDLE_VALUE), mapping(NULL)
+#endif
+{}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+bool MappedFile::Open(const std::string &fileName) {
+	Close();
+
+#ifdef _WIN32
+	file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+	mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (mapping == NULL) {
+		Close();
+		return false;
+	}
+	data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (data == NULL) {
+		Close();
+		return false;
+	}
+#else
+	int descriptor = open(fileName.c_str(), O_RDONLY);
+	if (descriptor < 0) {
+		return false;
+	}
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+		close(descriptor);
+		return false;
+	}
+	size = (size_t)status.st_size;
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+	if (data == MAP_FAILED) {
+		data = NULL;
+		Close();
+		return false;
+	}
+#endif
+	return true;
+}
+
+void MappedFile::Close() {
+#ifdef _WIN32
+	if (data != NULL) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping != NULL) {
+		CloseHandle(mapping);
+	}
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+	}
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (data != NULL) {
+		munmap(data, size);
+	}
+#endif
+	data = NULL;
+	size = 0;
+}
+
+void MappedFile::Swap(MappedFile &other) {
+	std::swap(data, other.data);
+	std::swap(size, other.size);
+#ifdef _WIN32
+	std::swap(file, other.file);
+	std::swap(mapping, other.mapping);
+#endif
+}
+
+bool fileIsCurrent(const std::string &derivedFile, const std::string &sourceFile) {
+	struct stat derivedStatus, sourceStatus;
+	if (stat(derivedFile.c_str(), &derivedStatus) != 0) {
+		return false;
+	}
+	return stat(sourceFile.c_str(), &sourceStatus) != 0 || derivedStatus.st_mtime >= sourceStatus.st_mtime;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+// a whole file mapped into memory, the pages are copy on write so the contents can be changed
+// in place without the file on disk ever changing
+class MappedFile {
+	public:
+		MappedFile();
+		~MappedFile();
+
+		// false when the file is missing or empty
+		bool Open(const std::string &fileName);
+		void Close();
+		// trades mappings, the memory stays where it is
+		void Swap(MappedFile &other);
+
+		void *data;
+		size_t size;
+
+	private:
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+#ifdef _WIN32
+		void *file;
+		void *mapping;
+#endif
+};
+
+// true when derivedFile exists and is not older than sourceFile, or sourceFile is gone
+// compiled levels and cooked textures are only used while this holds
+bool fileIsCurrent(const std::string &derivedFile, const std::string &sourceFile);
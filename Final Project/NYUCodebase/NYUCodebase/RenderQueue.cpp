@@ -0,0 +1,58 @@
+
+#include "RenderQueue.h"
+#include "ShaderProgram.h"
+#include <algorithm>
+
+RenderStats renderStats;
+
+// counts of the frame being drawn, copied into renderStats when it finishes
+static RenderStats frameStats;
+static GLuint boundTexture = 0;
+
+void BindTexture(GLuint texture) {
+	if (texture == boundTexture) {
+		return;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	boundTexture = texture;
+	frameStats.textureBinds++;
+}
+
+void CountDraw(int vertices) {
+	frameStats.drawCalls++;
+	frameStats.vertices += vertices;
+}
+
+// 4 bits of layer, 12 of program, 16 of texture, 16 of depth and 16 of submission order
+void RenderQueue::Submit(RenderLayer layer, GLuint program, GLuint texture, int depth, DrawFunction draw, int argument) {
+	Command command;
+	command.key = ((uint64_t)(layer & 0xF) << 60)
+		| ((uint64_t)(program & 0xFFF) << 48)
+		| ((uint64_t)(texture & 0xFFFF) << 32)
+		| ((uint64_t)(depth & 0xFFFF) << 16)
+		| (uint64_t)(commands.size() & 0xFFFF);
+	command.draw = draw;
+	command.argument = argument;
+	commands.push_back(command);
+}
+
+void RenderQueue::Execute() {
+	std::sort(commands.begin(), commands.end(), [](const Command &a, const Command &b) {
+		return a.key < b.key;
+	});
+
+	int programBindsBefore = ShaderProgram::programBinds;
+	for (const Command &command : commands) {
+		command.draw(command.argument);
+	}
+
+	frameStats.commands = (int)commands.size();
+	frameStats.programBinds = ShaderProgram::programBinds - programBindsBefore;
+	renderStats = frameStats;
+	frameStats = RenderStats();
+	commands.clear();
+}
+
+void RenderQueue::Clear() {
+	commands.clear();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include <vector>
+#include <cstdint>
+
+// drawn in this order, whatever order they were submitted in
+enum RenderLayer { LAYER_MAP, LAYER_ENTITIES, LAYER_OVERLAY, LAYER_TEXT };
+
+// what the last executed frame cost
+struct RenderStats {
+	int commands;
+	int drawCalls;
+	int textureBinds;
+	int programBinds;
+	int vertices;
+};
+
+extern RenderStats renderStats;
+
+// every texture bind and draw in the renderer goes through these, so the stats see them
+// and a texture that is already bound is not bound again
+void BindTexture(GLuint texture);
+void CountDraw(int vertices);
+
+// a frame's draws as small commands, sorted by layer, program, texture and depth before they run
+// so neighbouring commands share as much state as possible
+class RenderQueue {
+	public:
+		typedef void (*DrawFunction)(int argument);
+
+		// argument is handed back to draw, usually an index into the caller's own per-frame data
+		void Submit(RenderLayer layer, GLuint program, GLuint texture, int depth, DrawFunction draw, int argument);
+		void Execute();
+		void Clear();
+
+	private:
+		struct Command {
+			uint64_t key;
+			DrawFunction draw;
+			int argument;
+		};
+
+		std::vector<Command> commands;
+};
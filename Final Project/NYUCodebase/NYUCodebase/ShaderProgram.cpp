@@ -1,5 +1,18 @@
 
 #include "ShaderProgram.h"
+#include <string.h>
+
+GLuint ShaderProgram::boundProgram = 0;
+glm::mat4 ShaderProgram::cameraView = glm::mat4(1.0f);
+glm::mat4 ShaderProgram::cameraProjection = glm::mat4(1.0f);
+// programs start at 0, so the first Use always uploads the camera
+unsigned ShaderProgram::cameraVersion = 1;
+
+int ShaderProgram::programBinds = 0;
+int ShaderProgram::uniformUploads = 0;
+int ShaderProgram::skippedCalls = 0;
+
+ShaderProgram::ShaderProgram() : programID(0), uploadedCameraVersion(0), modelMatrixValid(false), colorValid(false) {}
 
 void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShaderFile) {
     
@@ -25,6 +38,10 @@ void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShade
     viewMatrixUniform = glGetUniformLocation(programID, "viewMatrix");
 	colorUniform = glGetUniformLocation(programID, "color");
     
+	uploadedCameraVersion = 0;
+	modelMatrixValid = false;
+	colorValid = false;
+
     positionAttribute = glGetAttribLocation(programID, "position");
     texCoordAttribute = glGetAttribLocation(programID, "texCoord");
 	
@@ -33,6 +50,9 @@ void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShade
 }
 
 void ShaderProgram::Cleanup() {
+	if (boundProgram == programID) {
+		boundProgram = 0;
+	}
     glDeleteProgram(programID);
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
@@ -83,22 +103,61 @@ GLuint ShaderProgram::LoadShaderFromString(const std::string &shaderContents, GL
     return shaderID;
 }
 
+void ShaderProgram::Use() {
+	if (boundProgram != programID) {
+		glUseProgram(programID);
+		boundProgram = programID;
+		programBinds++;
+	}
+	else {
+		skippedCalls++;
+	}
+
+	if (uploadedCameraVersion != cameraVersion) {
+		glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, &cameraView[0][0]);
+		glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, &cameraProjection[0][0]);
+		uploadedCameraVersion = cameraVersion;
+		uniformUploads += 2;
+	}
+}
+
 void ShaderProgram::SetColor(float r, float g, float b, float a) {
-	glUseProgram(programID);
+	Use();
+	float value[4] = { r, g, b, a };
+	if (colorValid && memcmp(color, value, sizeof(value)) == 0) {
+		skippedCalls++;
+		return;
+	}
 	glUniform4f(colorUniform, r, g, b, a);
+	memcpy(color, value, sizeof(value));
+	colorValid = true;
+	uniformUploads++;
 }
 
 void ShaderProgram::SetViewMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
-    glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
+	if (matrix == cameraView) {
+		return;
+	}
+	cameraView = matrix;
+	cameraVersion++;
 }
 
 void ShaderProgram::SetModelMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
+	Use();
+	if (modelMatrixValid && matrix == modelMatrix) {
+		skippedCalls++;
+		return;
+	}
     glUniformMatrix4fv(modelMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
+	modelMatrix = matrix;
+	modelMatrixValid = true;
+	uniformUploads++;
 }
 
 void ShaderProgram::SetProjectionMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
-    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, &matrix[0][0]);    
+	if (matrix == cameraProjection) {
+		return;
+	}
+	cameraProjection = matrix;
+	cameraVersion++;
 }
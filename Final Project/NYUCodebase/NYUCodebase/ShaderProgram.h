@@ -10,17 +10,29 @@
 #include <sstream>
 #include "glm/mat4x4.hpp"
 
+// remembers which program is bound and what each uniform holds, so unchanged state is never sent twice
+// view and projection are one camera shared by every program, a program picks up a new camera
+// the next time it is used
 class ShaderProgram {
     public:
+		ShaderProgram();
 	
 		void Load(const char *vertexShaderFile, const char *fragmentShaderFile);
 		void Cleanup();
 
+		// binds the program unless it already is, then uploads the camera if it changed since
+		void Use();
+
 		void SetModelMatrix(const glm::mat4 &matrix);
-        void SetProjectionMatrix(const glm::mat4 &matrix);
-        void SetViewMatrix(const glm::mat4 &matrix);
+        static void SetProjectionMatrix(const glm::mat4 &matrix);
+        static void SetViewMatrix(const glm::mat4 &matrix);
 	
 		void SetColor(float r, float g, float b, float a);
+
+		// glUseProgram and glUniform calls actually made, and the ones skipped
+		static int programBinds;
+		static int uniformUploads;
+		static int skippedCalls;
 	
         GLuint LoadShaderFromString(const std::string &shaderContents, GLenum type);
         GLuint LoadShaderFromFile(const std::string &shaderFile, GLenum type);
@@ -37,4 +49,16 @@ class ShaderProgram {
     
         GLuint vertexShader;
         GLuint fragmentShader;
+
+	private:
+		static GLuint boundProgram;
+		static glm::mat4 cameraView;
+		static glm::mat4 cameraProjection;
+		static unsigned cameraVersion;
+
+		unsigned uploadedCameraVersion;
+		bool modelMatrixValid;
+		glm::mat4 modelMatrix;
+		bool colorValid;
+		float color[4];
 };
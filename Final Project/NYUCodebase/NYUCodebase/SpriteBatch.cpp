@@ -0,0 +1,108 @@
+
+#include "SpriteBatch.h"
+#include "RenderQueue.h"
+
+SpriteBatch::SpriteBatch() : atlas(NULL), animationTime(0.0f), framesPerSecond(10.0f), drawCalls(0), spriteCount(0), usedBuckets(0), vertexBuffer(0) {}
+
+void SpriteBatch::Add(const SheetSprite &sprite, const glm::vec3 &position, bool flipX) {
+	GLuint texture = sprite.textureID;
+	float u = sprite.u;
+	float v = sprite.v;
+	float w = sprite.width;
+	float h = sprite.height;
+	u += sprite.Frame(animationTime, framesPerSecond) * w;
+	if (atlas != NULL && sprite.textureID != 0) {
+		atlas->Region(sprite.textureID).Map(u, v, w, h);
+		texture = atlas->texture;
+	}
+
+	// a handful of textures per frame, a linear search beats a map here
+	Bucket *bucket = NULL;
+	for (unsigned i = 0; i < usedBuckets; i++) {
+		if (buckets[i].texture == texture) {
+			bucket = &buckets[i];
+			break;
+		}
+	}
+	if (bucket == NULL) {
+		if (usedBuckets == buckets.size()) {
+			buckets.push_back(Bucket());
+		}
+		bucket = &buckets[usedBuckets++];
+		bucket->texture = texture;
+	}
+
+	// same quad as SheetSprite::Draw, mirrored the way a -1 x scale would
+	float halfWidth = (flipX ? -0.5f : 0.5f) * sprite.size;
+	float halfHeight = 0.5f * sprite.size;
+	float left = position.x - halfWidth;
+	float right = position.x + halfWidth;
+	float top = position.y + halfHeight;
+	float bottom = position.y - halfHeight;
+
+	bucket->vertices.insert(bucket->vertices.end(), {
+		left, bottom, u, v + h,
+		right, top, u + w, v,
+		left, top, u, v,
+		right, top, u + w, v,
+		left, bottom, u, v + h,
+		right, bottom, u + w, v + h
+	});
+}
+
+void SpriteBatch::Flush(ShaderProgram &program) {
+	drawCalls = 0;
+	spriteCount = 0;
+	if (usedBuckets == 0) {
+		return;
+	}
+
+	upload.clear();
+	for (unsigned i = 0; i < usedBuckets; i++) {
+		upload.insert(upload.end(), buckets[i].vertices.begin(), buckets[i].vertices.end());
+	}
+
+	if (vertexBuffer == 0) {
+		glGenBuffers(1, &vertexBuffer);
+	}
+
+	program.Use();
+	program.SetModelMatrix(glm::mat4(1.0f));
+
+	// a fresh data store every frame, the driver can keep the old one alive for the previous frame
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, upload.size() * sizeof(float), upload.data(), GL_STREAM_DRAW);
+
+	glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(program.positionAttribute);
+	glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(program.texCoordAttribute);
+
+	GLint first = 0;
+	for (unsigned i = 0; i < usedBuckets; i++) {
+		GLsizei count = (GLsizei)(buckets[i].vertices.size() / 4);
+		BindTexture(buckets[i].texture);
+		glDrawArrays(GL_TRIANGLES, first, count);
+		CountDraw(count);
+		first += count;
+		drawCalls++;
+		spriteCount += count / 6;
+
+		// clear keeps the capacity, so a steady scene stops allocating after the first frame
+		buckets[i].vertices.clear();
+	}
+	usedBuckets = 0;
+
+	glDisableVertexAttribArray(program.positionAttribute);
+	glDisableVertexAttribArray(program.texCoordAttribute);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SpriteBatch::Cleanup() {
+	if (vertexBuffer != 0) {
+		glDeleteBuffers(1, &vertexBuffer);
+	}
+	vertexBuffer = 0;
+	buckets.clear();
+	usedBuckets = 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include "ShaderProgram.h"
+#include "Game.h"
+#include "TextureAtlas.h"
+#include <vector>
+
+// collects the sprites of a frame as world space quads and draws them with one
+// glDrawArrays per texture out of a single streaming vertex buffer
+class SpriteBatch {
+	public:
+		SpriteBatch();
+
+		void Add(const SheetSprite &sprite, const glm::vec3 &position, bool flipX);
+		void Flush(ShaderProgram &program);
+		void Cleanup();
+
+		// when set, sprite texture ids are atlas handles and everything lands in one draw call
+		const TextureAtlas *atlas;
+
+		// the clock animated sprites pick their frame from
+		float animationTime;
+		float framesPerSecond;
+
+		// draw calls and sprites of the last flush
+		int drawCalls;
+		int spriteCount;
+
+	private:
+		// one list of interleaved x, y, u, v vertices per texture, in the order the textures were first added
+		struct Bucket {
+			GLuint texture;
+			std::vector<float> vertices;
+		};
+
+		std::vector<Bucket> buckets;
+		unsigned usedBuckets;
+		std::vector<float> upload;
+		GLuint vertexBuffer;
+};
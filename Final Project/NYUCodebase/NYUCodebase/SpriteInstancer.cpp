@@ -0,0 +1,169 @@
+
+#include "SpriteInstancer.h"
+#include "RenderQueue.h"
+#include <SDL.h>
+#include <stdio.h>
+
+#define INSTANCE_FLOATS 10
+
+SpriteInstancer::SpriteInstancer() : atlas(NULL), animationTime(0.0f), framesPerSecond(10.0f), drawCalls(0), spriteCount(0),
+	transformAttribute(-1), frameAttribute(-1), animationAttribute(-1), animationTimeUniform(-1), framesPerSecondUniform(-1),
+	drawArraysInstanced(NULL), vertexAttribDivisor(NULL), usedBuckets(0), quadBuffer(0), instanceBuffer(0) {}
+
+bool SpriteInstancer::Init(const char *vertexShaderFile, const char *fragmentShaderFile) {
+	// core since 3.3, before that it takes ARB_instanced_arrays
+	int major = 0;
+	int minor = 0;
+	const char *version = (const char*)glGetString(GL_VERSION);
+	if (version == NULL || sscanf(version, "%d.%d", &major, &minor) != 2) {
+		return false;
+	}
+	if (major > 3 || (major == 3 && minor >= 3)) {
+		drawArraysInstanced = (DrawArraysInstancedFunction)SDL_GL_GetProcAddress("glDrawArraysInstanced");
+		vertexAttribDivisor = (VertexAttribDivisorFunction)SDL_GL_GetProcAddress("glVertexAttribDivisor");
+	}
+	else if (SDL_GL_ExtensionSupported("GL_ARB_instanced_arrays") && SDL_GL_ExtensionSupported("GL_ARB_draw_instanced")) {
+		drawArraysInstanced = (DrawArraysInstancedFunction)SDL_GL_GetProcAddress("glDrawArraysInstancedARB");
+		vertexAttribDivisor = (VertexAttribDivisorFunction)SDL_GL_GetProcAddress("glVertexAttribDivisorARB");
+	}
+	if (drawArraysInstanced == NULL || vertexAttribDivisor == NULL) {
+		return false;
+	}
+
+	program.Load(vertexShaderFile, fragmentShaderFile);
+	transformAttribute = glGetAttribLocation(program.programID, "instanceTransform");
+	frameAttribute = glGetAttribLocation(program.programID, "instanceFrame");
+	animationAttribute = glGetAttribLocation(program.programID, "instanceAnimation");
+	animationTimeUniform = glGetUniformLocation(program.programID, "animationTime");
+	framesPerSecondUniform = glGetUniformLocation(program.programID, "framesPerSecond");
+	if (transformAttribute < 0 || frameAttribute < 0 || animationAttribute < 0) {
+		return false;
+	}
+
+	// the unit quad in the same winding as SheetSprite::Draw, texture y grows downwards
+	float quad[] = {
+		-0.5f, -0.5f, 0.0f, 1.0f,
+		0.5f, 0.5f, 1.0f, 0.0f,
+		-0.5f, 0.5f, 0.0f, 0.0f,
+		0.5f, 0.5f, 1.0f, 0.0f,
+		-0.5f, -0.5f, 0.0f, 1.0f,
+		0.5f, -0.5f, 1.0f, 1.0f
+	};
+	glGenBuffers(1, &quadBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return true;
+}
+
+void SpriteInstancer::Add(const SheetSprite &sprite, const glm::vec3 &position, bool flipX) {
+	GLuint texture = sprite.textureID;
+	float u = sprite.u;
+	float v = sprite.v;
+	float w = sprite.width;
+	float h = sprite.height;
+	if (atlas != NULL && sprite.textureID != 0) {
+		atlas->Region(sprite.textureID).Map(u, v, w, h);
+		texture = atlas->texture;
+	}
+
+	Bucket *bucket = NULL;
+	for (unsigned i = 0; i < usedBuckets; i++) {
+		if (buckets[i].texture == texture) {
+			bucket = &buckets[i];
+			break;
+		}
+	}
+	if (bucket == NULL) {
+		if (usedBuckets == buckets.size()) {
+			buckets.push_back(Bucket());
+		}
+		bucket = &buckets[usedBuckets++];
+		bucket->texture = texture;
+	}
+
+	bucket->instances.insert(bucket->instances.end(), {
+		position.x, position.y, flipX ? -sprite.size : sprite.size, sprite.size,
+		u, v, w, h,
+		(float)sprite.frameCount, sprite.phase
+	});
+}
+
+void SpriteInstancer::Flush() {
+	drawCalls = 0;
+	spriteCount = 0;
+	if (usedBuckets == 0) {
+		return;
+	}
+
+	upload.clear();
+	for (unsigned i = 0; i < usedBuckets; i++) {
+		upload.insert(upload.end(), buckets[i].instances.begin(), buckets[i].instances.end());
+	}
+
+	// the camera is shared, Use brings it up to date
+	program.Use();
+	glUniform1f(animationTimeUniform, animationTime);
+	glUniform1f(framesPerSecondUniform, framesPerSecond);
+
+	glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+	glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(program.positionAttribute);
+	glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(program.texCoordAttribute);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, upload.size() * sizeof(float), upload.data(), GL_STREAM_DRAW);
+	glEnableVertexAttribArray(transformAttribute);
+	glEnableVertexAttribArray(frameAttribute);
+	glEnableVertexAttribArray(animationAttribute);
+	vertexAttribDivisor(transformAttribute, 1);
+	vertexAttribDivisor(frameAttribute, 1);
+	vertexAttribDivisor(animationAttribute, 1);
+
+	size_t firstInstance = 0;
+	for (unsigned i = 0; i < usedBuckets; i++) {
+		GLsizei count = (GLsizei)(buckets[i].instances.size() / INSTANCE_FLOATS);
+		size_t offset = firstInstance * INSTANCE_FLOATS * sizeof(float);
+		glVertexAttribPointer(transformAttribute, 4, GL_FLOAT, false, INSTANCE_FLOATS * sizeof(float), (void*)offset);
+		glVertexAttribPointer(frameAttribute, 4, GL_FLOAT, false, INSTANCE_FLOATS * sizeof(float), (void*)(offset + 4 * sizeof(float)));
+		glVertexAttribPointer(animationAttribute, 2, GL_FLOAT, false, INSTANCE_FLOATS * sizeof(float), (void*)(offset + 8 * sizeof(float)));
+
+		BindTexture(buckets[i].texture);
+		drawArraysInstanced(GL_TRIANGLES, 0, 6, count);
+		CountDraw(6 * count);
+		firstInstance += count;
+		drawCalls++;
+		spriteCount += count;
+
+		buckets[i].instances.clear();
+	}
+	usedBuckets = 0;
+
+	// the divisors stick to the attribute slots, which the other programs share
+	vertexAttribDivisor(transformAttribute, 0);
+	vertexAttribDivisor(frameAttribute, 0);
+	vertexAttribDivisor(animationAttribute, 0);
+	glDisableVertexAttribArray(transformAttribute);
+	glDisableVertexAttribArray(frameAttribute);
+	glDisableVertexAttribArray(animationAttribute);
+	glDisableVertexAttribArray(program.positionAttribute);
+	glDisableVertexAttribArray(program.texCoordAttribute);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SpriteInstancer::Cleanup() {
+	if (quadBuffer != 0) {
+		glDeleteBuffers(1, &quadBuffer);
+		glDeleteBuffers(1, &instanceBuffer);
+	}
+	if (program.programID != 0) {
+		program.Cleanup();
+		program.programID = 0;
+	}
+	quadBuffer = 0;
+	instanceBuffer = 0;
+	buckets.clear();
+	usedBuckets = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include "ShaderProgram.h"
+#include "Game.h"
+#include "TextureAtlas.h"
+#include <vector>
+
+// draws every sprite sharing a texture with one glDrawArraysInstanced of a unit quad
+// each instance is 10 floats: position, signed size, the first frame's rectangle, frame count and phase
+// the vertex shader picks the frame from the animation clock
+class SpriteInstancer {
+	public:
+		SpriteInstancer();
+
+		// false when the context has no instanced arrays, the caller keeps using SpriteBatch then
+		bool Init(const char *vertexShaderFile, const char *fragmentShaderFile);
+
+		void Add(const SheetSprite &sprite, const glm::vec3 &position, bool flipX);
+		void Flush();
+		void Cleanup();
+
+		GLuint ProgramID() const { return program.programID; }
+
+		// when set, sprite texture ids are atlas handles
+		const TextureAtlas *atlas;
+
+		float animationTime;
+		float framesPerSecond;
+
+		// draw calls and sprites of the last flush
+		int drawCalls;
+		int spriteCount;
+
+	private:
+		typedef void (APIENTRY *DrawArraysInstancedFunction)(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+		typedef void (APIENTRY *VertexAttribDivisorFunction)(GLuint index, GLuint divisor);
+
+		struct Bucket {
+			GLuint texture;
+			std::vector<float> instances;
+		};
+
+		ShaderProgram program;
+		GLint transformAttribute;
+		GLint frameAttribute;
+		GLint animationAttribute;
+		GLint animationTimeUniform;
+		GLint framesPerSecondUniform;
+
+		DrawArraysInstancedFunction drawArraysInstanced;
+		VertexAttribDivisorFunction vertexAttribDivisor;
+
+		std::vector<Bucket> buckets;
+		unsigned usedBuckets;
+		std::vector<float> upload;
+		GLuint quadBuffer;
+		GLuint instanceBuffer;
+};
@@ -0,0 +1,109 @@
+
+#include "TextCache.h"
+#include "RenderQueue.h"
+#include <string.h>
+
+TextCache::TextCache() : rebuilds(0), frame(0) {}
+
+// same glyph layout as the old DrawText, 16 by 16 characters in the font sheet
+void TextCache::Build(Entry &entry, const AtlasRegion &region) {
+	float size = entry.size;
+	float spacing = entry.spacing;
+
+	vertices.clear();
+	for (unsigned i = 0; i < entry.text.size(); i++) {
+		int spriteIndex = (int)entry.text[i];
+
+		float texture_x = (float)(spriteIndex % 16) / 16.0f;
+		float texture_y = (float)(spriteIndex / 16) / 16.0f;
+		float character_width = 1.0 / 16.0f;
+		float character_size = 1.0 / 16.0f;
+		region.Map(texture_x, texture_y, character_width, character_size);
+
+		float left = ((size + spacing) * i) + (-0.5f * size);
+		float right = ((size + spacing) * i) + (0.5f * size);
+		float top = 0.5f * size;
+		float bottom = -0.5f * size;
+
+		vertices.insert(vertices.end(), {
+			left, top, texture_x, texture_y,
+			left, bottom, texture_x, texture_y + character_size,
+			right, top, texture_x + character_width, texture_y,
+			right, bottom, texture_x + character_width, texture_y + character_size,
+			right, top, texture_x + character_width, texture_y,
+			left, bottom, texture_x, texture_y + character_size
+		});
+	}
+
+	if (entry.vertexBuffer == 0) {
+		glGenBuffers(1, &entry.vertexBuffer);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, entry.vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	entry.vertexCount = (GLsizei)(vertices.size() / 4);
+	rebuilds++;
+}
+
+void TextCache::Draw(ShaderProgram &program, const TextureAtlas &atlas, unsigned int font, const char *text, float size, float spacing) {
+	Entry *entry = NULL;
+	Entry *stale = NULL;
+	for (Entry &candidate : entries) {
+		if (candidate.size == size && candidate.spacing == spacing && strcmp(candidate.text.c_str(), text) == 0) {
+			entry = &candidate;
+			break;
+		}
+		if (frame - candidate.lastFrame > TEXT_CACHE_FRAMES && (stale == NULL || candidate.lastFrame < stale->lastFrame)) {
+			stale = &candidate;
+		}
+	}
+
+	if (entry == NULL) {
+		if (stale == NULL) {
+			entries.push_back(Entry());
+			stale = &entries.back();
+			stale->vertexBuffer = 0;
+		}
+		entry = stale;
+		// assign reuses the capacity the old string had
+		entry->text.assign(text);
+		entry->size = size;
+		entry->spacing = spacing;
+		Build(*entry, atlas.Region(font));
+	}
+	entry->lastFrame = frame;
+
+	if (entry->vertexCount == 0) {
+		return;
+	}
+
+	BindTexture(atlas.texture);
+	program.Use();
+
+	glBindBuffer(GL_ARRAY_BUFFER, entry->vertexBuffer);
+	glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(program.positionAttribute);
+	glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(program.texCoordAttribute);
+
+	glDrawArrays(GL_TRIANGLES, 0, entry->vertexCount);
+	CountDraw(entry->vertexCount);
+
+	glDisableVertexAttribArray(program.positionAttribute);
+	glDisableVertexAttribArray(program.texCoordAttribute);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TextCache::EndFrame() {
+	frame++;
+}
+
+void TextCache::Cleanup() {
+	for (Entry &entry : entries) {
+		if (entry.vertexBuffer != 0) {
+			glDeleteBuffers(1, &entry.vertexBuffer);
+		}
+	}
+	entries.clear();
+}
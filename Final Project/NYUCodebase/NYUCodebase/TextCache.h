@@ -0,0 +1,46 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include "ShaderProgram.h"
+#include "TextureAtlas.h"
+#include <vector>
+#include <string>
+
+// frames a string may go undrawn before its buffer is handed to another string
+#define TEXT_CACHE_FRAMES 60
+
+// glyph quads of the strings drawn recently, kept in vertex buffers keyed by text, size and spacing
+// a string that changes gets the buffer of one that has not been drawn for a while, so a steady
+// HUD neither allocates nor rebuilds vertices
+class TextCache {
+	public:
+		TextCache();
+
+		void Draw(ShaderProgram &program, const TextureAtlas &atlas, unsigned int font, const char *text, float size, float spacing);
+		// call once per frame, after the last Draw
+		void EndFrame();
+		void Cleanup();
+
+		// meshes built since startup
+		int rebuilds;
+
+	private:
+		struct Entry {
+			std::string text;
+			float size;
+			float spacing;
+			GLuint vertexBuffer;
+			GLsizei vertexCount;
+			unsigned lastFrame;
+		};
+
+		void Build(Entry &entry, const AtlasRegion &region);
+
+		// the HUD has a handful of strings, a linear search is cheaper than hashing them
+		std::vector<Entry> entries;
+		std::vector<float> vertices;
+		unsigned frame;
+};
@@ -0,0 +1,164 @@
+
+#include "TextureAtlas.h"
+#include "RenderQueue.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <iostream>
+#include <assert.h>
+
+#define ATLAS_PADDING 1
+#define ATLAS_MAX_SIZE 4096
+
+TextureAtlas::TextureAtlas() : texture(0), width(0), height(0) {}
+
+unsigned int TextureAtlas::Add(const char *filePath) {
+	Image image;
+	image.filePath = filePath;
+	image.x = 0;
+	image.y = 0;
+	image.width = 0;
+	image.height = 0;
+	image.pixels = NULL;
+	image.cooked = NULL;
+	images.push_back(image);
+	return (unsigned int)images.size();
+}
+
+void TextureAtlas::Decode(unsigned int handle) {
+	Image &image = images[handle - 1];
+	image.cooked = new CookedTexture();
+	if (image.cooked->Open(image.filePath)) {
+		image.pixels = image.cooked->pixels;
+		image.width = image.cooked->width;
+		image.height = image.cooked->height;
+		return;
+	}
+	delete image.cooked;
+	image.cooked = NULL;
+
+	image.pixels = stbi_load(image.filePath.c_str(), &image.width, &image.height, NULL, STBI_rgb_alpha);
+
+	if (image.pixels == NULL) {
+		std::cout << "Unable to load image. Make sure the path is correct\n";
+		assert(false);
+	}
+}
+
+// fills shelves left to right, returns false if the images do not fit in this width
+bool TextureAtlas::Pack(int atlasWidth, int &atlasHeight) {
+	std::vector<int> order(images.size());
+	for (unsigned i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [this](int a, int b) {
+		if (images[a].height != images[b].height) {
+			return images[a].height > images[b].height;
+		}
+		return images[a].width > images[b].width;
+	});
+
+	int shelfX = 0;
+	int shelfY = 0;
+	int shelfHeight = 0;
+	for (int index : order) {
+		Image &image = images[index];
+		if (image.width > atlasWidth) {
+			return false;
+		}
+		if (shelfX + image.width > atlasWidth) {
+			shelfY += shelfHeight + ATLAS_PADDING;
+			shelfX = 0;
+			shelfHeight = 0;
+		}
+		image.x = shelfX;
+		image.y = shelfY;
+		shelfX += image.width + ATLAS_PADDING;
+		shelfHeight = std::max(shelfHeight, image.height);
+	}
+
+	atlasHeight = 1;
+	while (atlasHeight < shelfY + shelfHeight) {
+		atlasHeight *= 2;
+	}
+	return atlasHeight <= ATLAS_MAX_SIZE;
+}
+
+void TextureAtlas::Build() {
+	for (unsigned int i = 0; i < images.size(); i++) {
+		if (images[i].pixels == NULL) {
+			Decode(i + 1);
+		}
+	}
+
+	// the narrowest power of two width that still fits gives the smallest texture
+	int bestWidth = 0;
+	int bestHeight = 0;
+	for (int atlasWidth = 64; atlasWidth <= ATLAS_MAX_SIZE; atlasWidth *= 2) {
+		int atlasHeight;
+		if (Pack(atlasWidth, atlasHeight) && (bestWidth == 0 || atlasWidth * atlasHeight < bestWidth * bestHeight)) {
+			bestWidth = atlasWidth;
+			bestHeight = atlasHeight;
+		}
+	}
+	if (bestWidth == 0) {
+		std::cout << "Sprite sheets do not fit in one atlas\n";
+		assert(false);
+	}
+	Pack(bestWidth, bestHeight);
+	width = bestWidth;
+	height = bestHeight;
+
+	std::vector<unsigned char> pixels(width * height * 4, 0);
+	regions.clear();
+	for (Image &image : images) {
+		for (int row = 0; row < image.height; row++) {
+			std::copy(image.pixels + row * image.width * 4, image.pixels + (row + 1) * image.width * 4,
+				pixels.begin() + ((image.y + row) * width + image.x) * 4);
+		}
+		FreePixels(image);
+
+		AtlasRegion region;
+		region.u = (float)image.x / (float)width;
+		region.v = (float)image.y / (float)height;
+		region.width = (float)image.width / (float)width;
+		region.height = (float)image.height / (float)height;
+		regions.push_back(region);
+	}
+
+	if (texture == 0) {
+		glGenTextures(1, &texture);
+	}
+	BindTexture(texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void TextureAtlas::FreePixels(Image &image) {
+	if (image.cooked != NULL) {
+		delete image.cooked;
+	}
+	else if (image.pixels != NULL) {
+		stbi_image_free(image.pixels);
+	}
+	image.cooked = NULL;
+	image.pixels = NULL;
+}
+
+const AtlasRegion &TextureAtlas::Region(unsigned int handle) const {
+	return regions[handle - 1];
+}
+
+void TextureAtlas::Cleanup() {
+	if (texture != 0) {
+		BindTexture(0);
+		glDeleteTextures(1, &texture);
+	}
+	texture = 0;
+	for (Image &image : images) {
+		FreePixels(image);
+	}
+	images.clear();
+	regions.clear();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include "CookedTexture.h"
+#include <vector>
+#include <string>
+
+// where one source image ended up, in atlas uv
+struct AtlasRegion {
+	float u;
+	float v;
+	float width;
+	float height;
+
+	// takes u, v and size from the image's own 0 to 1 space into the atlas
+	void Map(float &spriteU, float &spriteV, float &spriteWidth, float &spriteHeight) const {
+		spriteU = u + spriteU * width;
+		spriteV = v + spriteV * height;
+		spriteWidth *= width;
+		spriteHeight *= height;
+	}
+};
+
+// packs every sprite sheet into one texture at startup so the scene never switches textures
+// images are placed on shelves, tallest first, with a transparent texel between neighbours
+class TextureAtlas {
+	public:
+		TextureAtlas();
+
+		// queues an image and returns its handle, which stands in for a texture id in SheetSprite
+		unsigned int Add(const char *filePath);
+		// maps the image's cooked file or decodes the image, safe to call from other threads for
+		// different handles. Build decodes whatever was not decoded yet
+		void Decode(unsigned int handle);
+		void Build();
+		void Cleanup();
+
+		// handles start at 1, 0 keeps meaning no texture
+		const AtlasRegion &Region(unsigned int handle) const;
+
+		GLuint texture;
+		int width;
+		int height;
+
+	private:
+		struct Image {
+			std::string filePath;
+			int x;
+			int y;
+			int width;
+			int height;
+			unsigned char *pixels;
+			// set when pixels point into a cooked file instead of stb_image memory
+			CookedTexture *cooked;
+		};
+
+		bool Pack(int atlasWidth, int &atlasHeight);
+		void FreePixels(Image &image);
+
+		std::vector<Image> images;
+		std::vector<AtlasRegion> regions;
+};
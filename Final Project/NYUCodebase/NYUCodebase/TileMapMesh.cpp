@@ -0,0 +1,158 @@
+
+#include "TileMapMesh.h"
+#include "RenderQueue.h"
+#include <math.h>
+#include <algorithm>
+
+TileMapMesh::TileMapMesh() : vertexBuffer(0), indexBuffer(0), indexCount(0), drawnChunks(0), drawCalls(0),
+	chunksX(0), chunksY(0), tileSize(0.0f) {}
+
+void TileMapMesh::Build(short **levelData, int mapWidth, int mapHeight, int spriteCountX, int spriteCountY, float tileSize, const AtlasRegion &region) {
+	Prepare(levelData, mapWidth, mapHeight, spriteCountX, spriteCountY, tileSize, region);
+	Upload();
+}
+
+void TileMapMesh::Prepare(short **levelData, int mapWidth, int mapHeight, int spriteCountX, int spriteCountY, float tileSize, const AtlasRegion &region) {
+	vertices.clear();
+	indices.clear();
+
+	float spriteWidth = 1.0f / (float)spriteCountX;
+	float spriteHeight = 1.0f / (float)spriteCountY;
+
+	this->tileSize = tileSize;
+	chunksX = (mapWidth + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+	chunksY = (mapHeight + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+	chunks.resize(chunksX * chunksY);
+
+	for (int chunkY = 0; chunkY < chunksY; chunkY++) {
+		for (int chunkX = 0; chunkX < chunksX; chunkX++) {
+			Chunk &chunk = chunks[chunkY * chunksX + chunkX];
+			chunk.firstIndex = (GLsizei)indices.size();
+
+			int endY = std::min((chunkY + 1) * TILE_CHUNK_SIZE, mapHeight);
+			int endX = std::min((chunkX + 1) * TILE_CHUNK_SIZE, mapWidth);
+			for (int y = chunkY * TILE_CHUNK_SIZE; y < endY; y++) {
+				for (int x = chunkX * TILE_CHUNK_SIZE; x < endX; x++) {
+					if (levelData[y][x] == 0) {
+						continue;
+					}
+					float u = (float)(((int)levelData[y][x]) % spriteCountX) / (float)spriteCountX;
+					float v = (float)(((int)levelData[y][x]) / spriteCountX) / (float)spriteCountY;
+					float w = spriteWidth;
+					float h = spriteHeight;
+					region.Map(u, v, w, h);
+
+					float left = tileSize * x;
+					float top = -tileSize * y;
+
+					GLuint first = (GLuint)(vertices.size() / 4);
+					vertices.insert(vertices.end(), {
+						left, top, u, v,
+						left, top - tileSize, u, v + h,
+						left + tileSize, top - tileSize, u + w, v + h,
+						left + tileSize, top, u + w, v
+					});
+					indices.insert(indices.end(), {
+						first, first + 1, first + 2,
+						first, first + 2, first + 3
+					});
+				}
+			}
+
+			chunk.indexCount = (GLsizei)indices.size() - chunk.firstIndex;
+		}
+	}
+}
+
+void TileMapMesh::Upload() {
+	if (vertexBuffer == 0) {
+		glGenBuffers(1, &vertexBuffer);
+		glGenBuffers(1, &indexBuffer);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	indexCount = (GLsizei)indices.size();
+	std::vector<float>().swap(vertices);
+	std::vector<GLuint>().swap(indices);
+}
+
+void TileMapMesh::Draw(ShaderProgram &program, GLuint texture, const glm::mat4 &viewProjection) {
+	drawnChunks = 0;
+	drawCalls = 0;
+	if (indexCount == 0) {
+		return;
+	}
+
+	// the world rectangle under the screen, from the four corners of clip space
+	glm::mat4 screenToWorld = glm::inverse(viewProjection);
+	float minX = INFINITY;
+	float maxX = -INFINITY;
+	float minY = INFINITY;
+	float maxY = -INFINITY;
+	for (int corner = 0; corner < 4; corner++) {
+		glm::vec4 world = screenToWorld * glm::vec4(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, 0.0f, 1.0f);
+		minX = std::min(minX, world.x / world.w);
+		maxX = std::max(maxX, world.x / world.w);
+		minY = std::min(minY, world.y / world.w);
+		maxY = std::max(maxY, world.y / world.w);
+	}
+
+	// tile rows grow downwards while world y grows upwards
+	float chunkSize = tileSize * TILE_CHUNK_SIZE;
+	int firstChunkX = std::max(0, (int)floorf(minX / chunkSize));
+	int lastChunkX = std::min(chunksX - 1, (int)floorf(maxX / chunkSize));
+	int firstChunkY = std::max(0, (int)floorf(-maxY / chunkSize));
+	int lastChunkY = std::min(chunksY - 1, (int)floorf(-minY / chunkSize));
+	if (firstChunkX > lastChunkX || firstChunkY > lastChunkY) {
+		return;
+	}
+
+	program.Use();
+	BindTexture(texture);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(program.positionAttribute);
+	glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(program.texCoordAttribute);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	for (int chunkY = firstChunkY; chunkY <= lastChunkY; chunkY++) {
+		// the visible chunks of one row sit next to each other in the index buffer
+		const Chunk &first = chunks[chunkY * chunksX + firstChunkX];
+		const Chunk &last = chunks[chunkY * chunksX + lastChunkX];
+		GLsizei count = last.firstIndex + last.indexCount - first.firstIndex;
+		drawnChunks += lastChunkX - firstChunkX + 1;
+		if (count == 0) {
+			continue;
+		}
+		glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)(first.firstIndex * sizeof(GLuint)));
+		CountDraw(count);
+		drawCalls++;
+	}
+
+	glDisableVertexAttribArray(program.positionAttribute);
+	glDisableVertexAttribArray(program.texCoordAttribute);
+
+	// everything else still draws from client memory, which needs the buffers unbound
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void TileMapMesh::Cleanup() {
+	if (vertexBuffer != 0) {
+		glDeleteBuffers(1, &vertexBuffer);
+		glDeleteBuffers(1, &indexBuffer);
+	}
+	vertexBuffer = 0;
+	indexBuffer = 0;
+	indexCount = 0;
+	chunks.clear();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#include <SDL_opengl.h>
+#include "ShaderProgram.h"
+#include "TextureAtlas.h"
+#include "glm/mat4x4.hpp"
+#include <vector>
+
+#define TILE_CHUNK_SIZE 16
+
+// the static tiles of a level, uploaded once into a vertex and an index buffer
+// every tile is 4 interleaved x, y, u, v vertices and 6 indices
+// tiles are grouped into TILE_CHUNK_SIZE square chunks, stored row by row, so only the
+// chunks under the camera are drawn
+class TileMapMesh {
+	public:
+		TileMapMesh();
+
+		// region is where the tileset sits in the bound texture
+		void Build(short **levelData, int mapWidth, int mapHeight, int spriteCountX, int spriteCountY, float tileSize, const AtlasRegion &region);
+		// the two halves of Build, Prepare makes no GL calls so it can run on a loading thread
+		// and Upload then runs on the thread that owns the context
+		void Prepare(short **levelData, int mapWidth, int mapHeight, int spriteCountX, int spriteCountY, float tileSize, const AtlasRegion &region);
+		void Upload();
+		// viewProjection is what the shader will apply, the screen edges are unprojected through it
+		void Draw(ShaderProgram &program, GLuint texture, const glm::mat4 &viewProjection);
+		void Cleanup();
+
+		GLuint vertexBuffer;
+		GLuint indexBuffer;
+		GLsizei indexCount;
+
+		// chunks and draw calls of the last Draw
+		int drawnChunks;
+		int drawCalls;
+
+	private:
+		struct Chunk {
+			GLsizei firstIndex;
+			GLsizei indexCount;
+		};
+
+		std::vector<Chunk> chunks;
+		// what Prepare made for Upload, freed once it is in the buffers
+		std::vector<float> vertices;
+		std::vector<GLuint> indices;
+		int chunksX;
+		int chunksY;
+		float tileSize;
+};
@@ -0,0 +1,441 @@
+// runs game turns without a window or GPU so the simulation can be timed on its own
+//
+// Headless [--turns N] [--seed N] [--path astar|jps|flow|incremental|hierarchical]
+//          [--script file] [--synthetic WxH]... [map files]...
+// Headless --compile map.txt|WxH output.lvl
+// Headless --cook image.png...
+// Headless --texture-benchmark image.png...
+// Headless --parse-benchmark [WxH]
+//
+// without maps it plays level1.txt to level3.txt and a 256x256 synthetic map. inputs are
+// random unless a script of U, D, L and R characters is given, which is replayed in a loop
+// --compile writes the binary level the game loads instead of the text export, a WxH input
+// compiles a synthetic map, and then times loading both. --cook writes the raw RGBA file the
+// game maps instead of decoding the png, and --texture-benchmark times both ways of loading.
+// --parse-benchmark reads a synthetic map, 4096x4096 unless given, with the old line by line
+// reader and with the tokenizer
+
+#include "Game.h"
+#include "CookedTexture.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <algorithm>
+using namespace std;
+
+#define FIXED_TIMESTEP 0.01666666f
+// the movement delay lets two frames of the 10 fps animation pass between player actions
+#define FRAMES_PER_TURN 2
+#define FLOOR_TILE 24
+#define WALL_TILE 3
+
+// every allocation is counted, the turn loop reads the counter around each turn
+atomic<long long> allocationCount(0);
+
+void* operator new(size_t size) {
+	allocationCount++;
+	void* memory = malloc(size ? size : 1);
+	if (memory == NULL) {
+		throw bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+struct MapSource {
+	string name;
+	string text;
+};
+
+// a walled room with 2x2 pillars and a skull on about every sixteenth floor tile
+MapSource syntheticMap(int width, int height, uint32_t seed) {
+	vector<int> tiles(width * height, FLOOR_TILE);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			bool border = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+			bool pillar = x % 6 >= 3 && x % 6 <= 4 && y % 6 >= 3 && y % 6 <= 4
+				&& philox(x / 6, y / 6, seed) % 3 != 0;
+			if (border || pillar) {
+				tiles[y * width + x] = WALL_TILE;
+			}
+		}
+	}
+
+	int playerX = width / 2;
+	int playerY = height / 2;
+	int exitX = width - 2;
+	int exitY = height - 2;
+	tiles[playerY * width + playerX] = FLOOR_TILE;
+	tiles[exitY * width + exitX] = FLOOR_TILE;
+
+	ostringstream text;
+	text << "[header]\nwidth=" << width << "\nheight=" << height << "\n\n[layer]\ndata=\n";
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			text << tiles[y * width + x] << (x + 1 < width || y + 1 < height ? "," : "");
+		}
+		text << "\n";
+	}
+	text << "\n";
+
+	// entity locations are one tile lower than the layer, same as the Tiled export
+	text << "[Entity]\ntype=Player\nlocation=" << playerX << "," << playerY + 1 << ",1,1\n\n";
+	text << "[Entity]\ntype=Exit\nlocation=" << exitX << "," << exitY + 1 << ",1,1\n\n";
+	for (int y = 1; y < height - 1; y++) {
+		for (int x = 1; x < width - 1; x++) {
+			bool nearPlayer = abs(x - playerX) + abs(y - playerY) <= SIGHT_RADIUS + 1;
+			if (tiles[y * width + x] == FLOOR_TILE && !nearPlayer && !(x == exitX && y == exitY)
+				&& philox(x, y, seed ^ 0x5EED) % 16 == 0) {
+				text << "[Entity]\ntype=Skull\nlocation=" << x << "," << y + 1 << ",1,1\n\n";
+			}
+		}
+	}
+
+	MapSource source;
+	source.name = "synthetic " + to_string(width) + "x" + to_string(height);
+	source.text = text.str();
+	return source;
+}
+
+bool loadMapFile(const string& fileName, MapSource& source) {
+	ifstream infile(fileName);
+	if (!infile) {
+		return false;
+	}
+	ostringstream text;
+	text << infile.rdbuf();
+	source.name = fileName;
+	source.text = text.str();
+	return true;
+}
+
+void startLevel(const MapSource& source) {
+	keyCount = 0;
+	string error;
+	if (!setupScene(source.text.data(), source.text.size(), source.name, error)) {
+		fprintf(stderr, "%s:%s\n", source.name.c_str(), error.c_str());
+		exit(1);
+	}
+	state = STATE_GAME;
+}
+
+// the same steps the window runs between two player actions
+void simulateTurn(Direction action) {
+	player.Update(FIXED_TIMESTEP);
+	playerAction(action);
+	for (int frame = 0; frame < FRAMES_PER_TURN; frame++) {
+		animationTick(FIXED_TIMESTEP);
+		resolveKeys();
+		resolveSwords();
+		checkLevelOutcome();
+	}
+	gameEvents = GameEvents();
+}
+
+// milliseconds for one load of the level
+double timeLoad(const MapSource& source, bool compiled, const string& compiledFile) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if (compiled) {
+		setupScene(compiledFile);
+	}
+	else {
+		string error;
+		setupScene(source.text.data(), source.text.size(), source.name, error);
+	}
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e3;
+}
+
+int compileMap(const string& input, const string& output) {
+	MapSource source;
+	int width, height;
+	if (!loadMapFile(input, source)) {
+		if (sscanf(input.c_str(), "%dx%d", &width, &height) != 2 || width < 8 || height < 8) {
+			fprintf(stderr, "could not open %s\n", input.c_str());
+			return 1;
+		}
+		source = syntheticMap(width, height, gameSeed);
+	}
+
+	string error;
+	if (!compileLevel(source.text.data(), source.text.size(), source.name, output, error)) {
+		fprintf(stderr, "%s:%s\n", source.name.c_str(), error.c_str());
+		return 1;
+	}
+
+	// best of a few loads, the first one also pays for the page cache
+	double textTime = 1e30;
+	double compiledTime = 1e30;
+	for (int i = 0; i < 5; i++) {
+		textTime = min(textTime, timeLoad(source, false, output));
+		compiledTime = min(compiledTime, timeLoad(source, true, output));
+	}
+	printf("%s: %dx%d, %d skulls, text load %.2f ms, compiled load %.2f ms\n", output.c_str(), mapWidth, mapHeight,
+		(int)enemies.size(), textTime, compiledTime);
+	return 0;
+}
+
+// reads the same text with both parsers, without putting the level in play
+int benchmarkParsing(int width, int height) {
+	MapSource source = syntheticMap(width, height, gameSeed);
+	double megabytes = source.text.size() / 1e6;
+
+	istringstream stream(source.text);
+	LoadedLevel streamLevel;
+	long long allocationsBefore = allocationCount;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	readLevel(stream, streamLevel);
+	double streamSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	long long streamAllocations = allocationCount - allocationsBefore;
+	int streamSkulls = 0;
+	for (const LevelFileEntity& entity : streamLevel.entities) {
+		streamSkulls += entity.type == ENTITY_SKULL;
+	}
+
+	LoadedLevel tokenizerLevel;
+	string error;
+	allocationsBefore = allocationCount;
+	start = chrono::steady_clock::now();
+	if (!readLevel(source.text.data(), source.text.size(), tokenizerLevel, error)) {
+		fprintf(stderr, "%s:%s\n", source.name.c_str(), error.c_str());
+		return 1;
+	}
+	double tokenizerSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	long long tokenizerAllocations = allocationCount - allocationsBefore;
+
+	if (streamLevel.tileStorage != tokenizerLevel.tileStorage || streamLevel.entities.size() != tokenizerLevel.entities.size()) {
+		fprintf(stderr, "the parsers disagree on %s\n", source.name.c_str());
+		return 1;
+	}
+
+	printf("%s, %.1f MB, %d skulls\n", source.name.c_str(), megabytes, streamSkulls);
+	printf("%-12s %10s %10s %14s\n", "parser", "ms", "MB/s", "allocations");
+	printf("%-12s %10.1f %10.1f %14lld\n", "stream", streamSeconds * 1e3, megabytes / streamSeconds, streamAllocations);
+	printf("%-12s %10.1f %10.1f %14lld\n", "tokenizer", tokenizerSeconds * 1e3, megabytes / tokenizerSeconds, tokenizerAllocations);
+	return 0;
+}
+
+int cookImages(int count, char *files[]) {
+	for (int i = 0; i < count; i++) {
+		if (!cookTexture(files[i])) {
+			fprintf(stderr, "could not cook %s\n", files[i]);
+			return 1;
+		}
+		printf("%s -> %s\n", files[i], cookedTextureName(files[i]).c_str());
+	}
+	return 0;
+}
+
+// milliseconds per load, best of a few runs. the checksum makes the mapped pages really be read
+int benchmarkImages(int count, char *files[]) {
+	const int runs = 20;
+	printf("%-28s %9s %10s %10s %10s\n", "image", "size", "png ms", "cooked ms", "speedup");
+	for (int i = 0; i < count; i++) {
+		CookedTexture cooked;
+		if (!cooked.Open(files[i]) && (!cookTexture(files[i]) || !cooked.Open(files[i]))) {
+			fprintf(stderr, "could not cook %s\n", files[i]);
+			return 1;
+		}
+		cooked.Close();
+
+		double pngTime = 1e30;
+		double cookedTime = 1e30;
+		unsigned checksum = 0;
+		int width = 0;
+		int height = 0;
+		for (int run = 0; run < runs; run++) {
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			unsigned char *pixels = stbi_load(files[i], &width, &height, NULL, STBI_rgb_alpha);
+			for (int texel = 0; texel < width * height; texel++) {
+				checksum += pixels[texel * 4];
+			}
+			stbi_image_free(pixels);
+			pngTime = min(pngTime, chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e3);
+
+			start = chrono::steady_clock::now();
+			cooked.Open(files[i]);
+			for (int texel = 0; texel < cooked.width * cooked.height; texel++) {
+				checksum -= cooked.pixels[texel * 4];
+			}
+			cooked.Close();
+			cookedTime = min(cookedTime, chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e3);
+		}
+		if (checksum != 0) {
+			fprintf(stderr, "%s: cooked pixels differ from the png\n", files[i]);
+			return 1;
+		}
+		printf("%-28s %4dx%-4d %10.3f %10.3f %9.1fx\n", files[i], width, height, pngTime, cookedTime, pngTime / cookedTime);
+	}
+	return 0;
+}
+
+Direction scriptedAction(const string& script, int turn) {
+	switch (script[turn % script.size()]) {
+	case 'U':
+		return DIRECTION_UP;
+	case 'D':
+		return DIRECTION_DOWN;
+	case 'L':
+		return DIRECTION_LEFT;
+	default:
+		return DIRECTION_RIGHT;
+	}
+}
+
+void runMap(const MapSource& source, int turns, const string& script) {
+	startLevel(source);
+	int skullCount = enemies.size();
+
+	vector<double> latencies;
+	latencies.reserve(turns);
+	long long allocations = 0;
+	int restarts = 0;
+	double totalSeconds = 0.0;
+
+	for (int turn = 0; turn < turns; turn++) {
+		Direction action;
+		if (script.empty()) {
+			action = (Direction)(DIRECTION_UP + philox(turn, 1, gameSeed) % 4);
+		}
+		else {
+			action = scriptedAction(script, turn);
+		}
+
+		long long allocationsBefore = allocationCount;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		simulateTurn(action);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		allocations += allocationCount - allocationsBefore;
+
+		latencies.push_back(seconds * 1e6);
+		totalSeconds += seconds;
+
+		// dying or finishing starts the level over, loading is not part of the turn time
+		if (state != STATE_GAME) {
+			restarts++;
+			startLevel(source);
+		}
+	}
+
+	sort(latencies.begin(), latencies.end());
+	double p50 = latencies[latencies.size() / 2];
+	double p99 = latencies[latencies.size() * 99 / 100];
+	printf("%-20s %4dx%-4d %7d %12.0f %10.2f %10.2f %12.2f %9d\n", source.name.c_str(), mapWidth, mapHeight,
+		skullCount, turns / totalSeconds, p50, p99, (double)allocations / turns, restarts);
+}
+
+int main(int argc, char *argv[])
+{
+	int turns = 2000;
+	string script;
+	vector<MapSource> maps;
+	gameSeed = 1;
+
+	for (int i = 1; i < argc; i++) {
+		string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (argument == "--compile" && i + 2 < argc) {
+			return compileMap(argv[i + 1], argv[i + 2]);
+		}
+		else if (argument == "--parse-benchmark") {
+			int width = 4096;
+			int height = 4096;
+			if (hasValue && (sscanf(argv[i + 1], "%dx%d", &width, &height) != 2 || width < 8 || height < 8)) {
+				fprintf(stderr, "synthetic maps are given as WxH, at least 8x8\n");
+				return 1;
+			}
+			return benchmarkParsing(width, height);
+		}
+		else if (argument == "--cook" && hasValue) {
+			return cookImages(argc - i - 1, argv + i + 1);
+		}
+		else if (argument == "--texture-benchmark" && hasValue) {
+			return benchmarkImages(argc - i - 1, argv + i + 1);
+		}
+		else if (argument == "--turns" && hasValue) {
+			turns = atoi(argv[++i]);
+		}
+		else if (argument == "--seed" && hasValue) {
+			gameSeed = (uint32_t)strtoul(argv[++i], NULL, 10);
+		}
+		else if (argument == "--path" && hasValue) {
+			if (!pathModeFromName(argv[++i], pathMode)) {
+				fprintf(stderr, "unknown path mode %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (argument == "--script" && hasValue) {
+			ifstream infile(argv[++i]);
+			char c;
+			while (infile.get(c)) {
+				c = toupper(c);
+				if (c == 'U' || c == 'D' || c == 'L' || c == 'R') {
+					script += c;
+				}
+			}
+			if (script.empty()) {
+				fprintf(stderr, "no moves in script %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (argument == "--synthetic" && hasValue) {
+			int width, height;
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width < 8 || height < 8) {
+				fprintf(stderr, "synthetic maps are given as WxH, at least 8x8\n");
+				return 1;
+			}
+			maps.push_back(syntheticMap(width, height, gameSeed));
+		}
+		else if (argument[0] != '-') {
+			MapSource source;
+			if (!loadMapFile(argument, source)) {
+				fprintf(stderr, "could not open %s\n", argument.c_str());
+				return 1;
+			}
+			maps.push_back(source);
+		}
+		else {
+			fprintf(stderr, "usage: %s [--turns N] [--seed N] [--path astar|jps|flow|incremental|hierarchical]"
+				" [--script file] [--synthetic WxH]... [map files]...\n"
+				"       %s --compile map.txt|WxH output.lvl\n"
+				"       %s --cook image.png...\n"
+				"       %s --texture-benchmark image.png...\n"
+				"       %s --parse-benchmark [WxH]\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
+			return 1;
+		}
+	}
+
+	if (maps.empty()) {
+		const char* levels[] = { "level1.txt", "level2.txt", "level3.txt" };
+		for (int i = 0; i < 3; i++) {
+			MapSource source;
+			if (loadMapFile(levels[i], source)) {
+				maps.push_back(source);
+			}
+		}
+		maps.push_back(syntheticMap(256, 256, gameSeed));
+	}
+	if (turns <= 0) {
+		fprintf(stderr, "need at least one turn\n");
+		return 1;
+	}
+
+	printf("%-20s %9s %7s %12s %10s %10s %12s %9s\n", "map", "size", "skulls", "turns/s", "p50 us", "p99 us",
+		"allocs/turn", "restarts");
+	for (unsigned i = 0; i < maps.size(); i++) {
+		runMap(maps[i], turns, script);
+	}
+	return 0;
+}
@@ -13,21 +13,24 @@
 #endif
 
 #include "ShaderProgram.h"
+#include "Game.h"
+#include "TileMapMesh.h"
+#include "LevelPreloader.h"
+#include "SpriteBatch.h"
+#include "SpriteInstancer.h"
+#include "TextureAtlas.h"
+#include "TextCache.h"
+#include "RenderQueue.h"
+#include "AssetLoader.h"
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
 #include <vector>
-
-// for parsing map
-#include <fstream>
 #include <string>
 #include <iostream>
-#include <sstream>
-
-// for AI
-#include <queue>
-#include <utility> // for pair
-#include <tuple>
+#include <algorithm>
 using namespace std;
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -37,36 +40,23 @@ using namespace std;
 #define MAX_TIMESTEPS 6
 float accumulator = 0.0f;
 
-#define MAP_TILE_SIZE 0.1f
-#define LEVEL_1_WIDTH 20
-#define LEVEL_1_HEIGHT 10
-#define LEVEL_2_WIDTH 40
-#define LEVEL_2_HEIGHT 21
-#define LEVEL_3_WIDTH 30
-#define LEVEL_3_HEIGHT 30
 #define MAP_SPRITE_COUNT_X 10
 #define MAP_SPRITE_COUNT_Y 10
 
 #define MOVEMENT_DELAY 0.2f
 #define FADEOUT_TIME 3.0f
-
-enum GameState { STATE_TITLE, STATE_GAME, STATE_GAMEOVER, STATE_NEXT_LEVEL };
-enum EntityType { ENTITY_NONE, ENTITY_PLAYER, ENTITY_SKULL, ENTITY_TORCH, ENTITY_SIDE_TORCH, ENTITY_DOOR, ENTITY_KEY, ENTITY_EXIT, ENTITY_SWORD };
-enum EntityState { ENTITY_IDLE, ENTITY_CHASE };
-enum Direction { DIRECTION_NONE, DIRECTION_UP, DIRECTION_DOWN, DIRECTION_LEFT, DIRECTION_RIGHT };
-
-GameState state;
+// longest sleep on a screen where nothing moves, keeps the stats in the title fresh
+#define IDLE_WAIT 1.0f
 
 ShaderProgram program;
+ShaderProgram untexturedProgram;
 glm::mat4 modelMatrix;
 glm::mat4 viewMatrix;
 
-// for animation
-const int animationFrames[] = { 0, 1, 2, 3 };
-const int numFrames = 4;
+// for animation, sprites pick their frame from animationTime when they are drawn
+float animationTime = 0.0f;
 float animationElapsed = 0.0f;
 float framesPerSecond = 10.0f;
-int currentIndex = 0;
 float fadeout = 0.0f;
 
 // for sound
@@ -76,806 +66,258 @@ Mix_Chunk *keySound;
 Mix_Chunk *doorSound;
 Mix_Music *bgm;
 
-int mapWidth;
-int mapHeight;
-short **levelData;
-EntityType **entityPositionData; // for movement checks
+// every sheet lives in one texture, the sprite sheet globals hold atlas handles
+TextureAtlas atlas;
+unsigned int font;
 
-GLuint font;
-GLuint playerSpriteSheet;
-GLuint skullSpriteSheet;
-GLuint torchSpriteSheet;
-GLuint sideTorchSpriteSheet;
-GLuint keySpriteSheet;
-GLuint mapSpriteSheet;
-GLuint swordSprite;
-string gameOverMessage = "";
+// files are decoded on loader threads, only the atlas upload runs on the GL thread
+AssetLoader imageLoader;
+AssetLoader soundLoader;
+// the sound globals belong to soundLoader until this is set
+bool soundsLoaded = false;
 
-int currentLevel = 1;
-int keyCount = 0;
+struct SoundAsset {
+	Mix_Chunk **chunk;
+	const char *filePath;
+};
 
-SDL_Window* displayWindow;
+SoundAsset soundAssets[] = {
+	{ &hit_wall, RESOURCE_FOLDER"hit_wall.wav" },
+	{ &keySound, RESOURCE_FOLDER"key.wav" },
+	{ &doorSound, RESOURCE_FOLDER"door.wav" },
+	{ &swordSound, RESOURCE_FOLDER"sword.wav" }
+};
 
-float lerp(float v0, float v1, float t) {
-	return (1.0 - t) * v0 + t * v1;
+void decodeImage(int handle) {
+	atlas.Decode(handle);
 }
 
-GLuint LoadTexture(const char *filePath)
-{
-	int w, h, comp;
-	unsigned char* image = stbi_load(filePath, &w, &h, &comp, STBI_rgb_alpha);
-
-	if (image == NULL) {
-		std::cout << "Unable to load image. Make sure the path is correct\n";
-		assert(false);
-	}
-
-	GLuint retTexture;
-	glGenTextures(1, &retTexture);
-	glBindTexture(GL_TEXTURE_2D, retTexture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	stbi_image_free(image);
-	return retTexture;
+// queues the image in the atlas and its decoding on the loader
+unsigned int loadImage(const char *filePath) {
+	unsigned int handle = atlas.Add(filePath);
+	imageLoader.Add(decodeImage, handle);
+	return handle;
 }
 
-void DrawText(ShaderProgram &program, int fontTexture, std::string text, float size, float spacing) {
-	float character_size = 1.0 / 16.0f;
-
-	std::vector<float> vertexData;
-	std::vector<float> texCoordData;
-
-	for (unsigned i = 0; i < text.size(); i++) {
-		int spriteIndex = (int)text[i];
-
-		float texture_x = (float)(spriteIndex % 16) / 16.0f;
-		float texture_y = (float)(spriteIndex / 16) / 16.0f;
-
-		vertexData.insert(vertexData.end(), {
-			((size + spacing) * i) + (-0.5f * size), 0.5f * size,
-			((size + spacing) * i) + (-0.5f * size), -0.5f * size,
-			((size + spacing) * i) + (0.5f * size), 0.5f * size,
-			((size + spacing) * i) + (0.5f * size), -0.5f * size,
-			((size + spacing) * i) + (0.5f * size), 0.5f * size,
-			((size + spacing) * i) + (-0.5f * size), -0.5f * size,
-			});
-
-		texCoordData.insert(texCoordData.end(), {
-			texture_x, texture_y,
-			texture_x, texture_y + character_size,
-			texture_x + character_size, texture_y,
-			texture_x + character_size, texture_y + character_size,
-			texture_x + character_size, texture_y,
-			texture_x, texture_y + character_size,
-			});
-	}
-
-	glBindTexture(GL_TEXTURE_2D, fontTexture);
-	glUseProgram(program.programID);
-
-	glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 0, vertexData.data());
-	glEnableVertexAttribArray(program.positionAttribute);
-	glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoordData.data());
-	glEnableVertexAttribArray(program.texCoordAttribute);
-
-	glDrawArrays(GL_TRIANGLES, 0, text.size() * 6);
-
-	glDisableVertexAttribArray(program.positionAttribute);
-	glDisableVertexAttribArray(program.texCoordAttribute);
+void loadSound(int index) {
+	*soundAssets[index].chunk = Mix_LoadWAV(soundAssets[index].filePath);
 }
 
-class SheetSprite {
-public:
-	SheetSprite() {}
-	SheetSprite(unsigned int textureID, float u, float v, float width, float height, float size) {
-		this->textureID = textureID;
-		this->u = u;
-		this->v = v;
-		this->width = width;
-		this->height = height;
-		this->size = size;
-	}
-
-	void Draw(ShaderProgram &program) {
-glBindTexture(GL_TEXTURE_2D, textureID);
-
-GLfloat texCoords[] = {
-	u, v + height,
-	u + width, v,
-	u, v,
-	u + width, v,
-	u, v + height,
-	u + width, v + height
-};
-
-float aspect = 1;
+void loadMusic(int) {
+	bgm = Mix_LoadMUS(RESOURCE_FOLDER"TRG_Banks_Christmas_Town.mp3");
+}
 
-float vertices[] = {
-	-0.5f * size * aspect, -0.5f * size,
-	0.5f * size * aspect, 0.5f * size,
-	-0.5f * size * aspect, 0.5f * size,
-	0.5f * size * aspect, 0.5f * size,
-	-0.5f * size * aspect, -0.5f * size,
-	0.5f * size * aspect, -0.5f * size,
-};
+// when main started, the startup timings are measured from here
+Uint64 startupCounter;
 
-glUseProgram(program.programID);
+float startupMilliseconds() {
+	return (float)(SDL_GetPerformanceCounter() - startupCounter) * 1000.0f / (float)SDL_GetPerformanceFrequency();
+}
 
-glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-glEnableVertexAttribArray(program.positionAttribute);
-glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
-glEnableVertexAttribArray(program.texCoordAttribute);
+SDL_Window* displayWindow;
 
-glDrawArrays(GL_TRIANGLES, 0, 6);
+float lerp(float v0, float v1, float t) {
+	return (1.0 - t) * v0 + t * v1;
+}
 
-glDisableVertexAttribArray(program.positionAttribute);
-glDisableVertexAttribArray(program.texCoordAttribute);
-	}
+TextCache textCache;
+RenderQueue renderQueue;
 
+// what the queued commands of this frame need, indexed by their argument
+struct TextDraw {
+	ShaderProgram *program;
+	unsigned int fontTexture;
+	glm::mat4 model;
+	size_t textOffset;
 	float size;
-	unsigned int textureID;
-	float u;
-	float v;
-	float width;
-	float height;
+	float spacing;
 };
 
-void worldToTileCoordinates(float worldX, float worldY, int& gridX, int& gridY) {
-	gridX = (int)(worldX / MAP_TILE_SIZE);
-	gridY = (int)(worldY / -MAP_TILE_SIZE);
-}
+std::vector<TextDraw> textDraws;
+std::vector<char> textStorage;
+glm::mat4 mapViewProjection;
+glm::vec3 fadeCenter;
+float fadeAlpha;
 
-bool isSolid(int tileIndex) {
-	// the walls
-	return ((tileIndex >= 0 && tileIndex <= 5)
-		|| tileIndex == 10 || tileIndex == 15
-		|| tileIndex == 10 || tileIndex == 15
-		|| tileIndex == 20 || tileIndex == 25
-		|| tileIndex == 30 || tileIndex == 35
-		|| (tileIndex >= 40 && tileIndex <= 45)
-		|| (tileIndex >= 50 && tileIndex <= 55));
+void runTextCommand(int index) {
+	const TextDraw &draw = textDraws[index];
+	draw.program->SetModelMatrix(draw.model);
+	textCache.Draw(*draw.program, atlas, draw.fontTexture, &textStorage[draw.textOffset], draw.size, draw.spacing);
 }
 
-int distance(int tileX, int tileY, int goalX, int goalY) {
-	return abs(tileX - goalX) + abs(tileY - goalY);
+// queues the text, it is copied so a temporary buffer is fine
+void DrawText(ShaderProgram &program, unsigned int fontTexture, const glm::mat4 &model, const char *text, float size, float spacing) {
+	TextDraw draw;
+	draw.program = &program;
+	draw.fontTexture = fontTexture;
+	draw.model = model;
+	draw.textOffset = textStorage.size();
+	draw.size = size;
+	draw.spacing = spacing;
+	textStorage.insert(textStorage.end(), text, text + strlen(text) + 1);
+	textDraws.push_back(draw);
+	renderQueue.Submit(LAYER_TEXT, program.programID, atlas.texture, 0, runTextCommand, (int)textDraws.size() - 1);
 }
 
-struct TupleCompare {
-	bool operator()(const tuple<int, int, int, int>& first, const tuple<int, int, int, int>& second) {
-		return get<2>(first) + get<3>(first) > get<2>(second) + get<3>(second);
-	}
-};
-
-Direction aStarSearch(int tileX, int tileY, int goalX, int goalY) {
-	Direction result = DIRECTION_NONE;
-
-	// stores the cost for each position in the level
-	// tuple<prevX, prevY, cost>
-	vector<vector<tuple<int, int, int>>> path(mapHeight,
-		vector<tuple<int, int, int>>(mapWidth, make_tuple(INT_MAX, INT_MAX, INT_MAX)));
-
-	path[tileY][tileX] = make_tuple(-1, -1, 0);
-
-	// pq contains tuple<tileX, tileY, cost, distance>
-	priority_queue<tuple<int, int, int, int>, vector<tuple<int, int, int, int>>, TupleCompare> pq;
-	pq.push(make_tuple(tileX, tileY, 0, distance(tileX, tileY, goalX, goalY)));
-	int currentX = -1, currentY = -1;
-
-	while (!pq.empty()) {
-		currentX = get<0>(pq.top());
-		currentY = get<1>(pq.top());
-		int currentCost = get<2>(pq.top());
-		int currentDist = get<3>(pq.top());
-		pq.pop();
-
-		if (currentX == goalX && currentY == goalY) {
-			break;
-		}
-
-		// check each direction
-		if (!isSolid(levelData[currentY + 1][currentX])
-			&& entityPositionData[currentY + 1][currentX] != ENTITY_SKULL
-			&& entityPositionData[currentY + 1][currentX] != ENTITY_DOOR) {
-
-			if (currentCost + 1 < get<2>(path[currentY + 1][currentX])) {
-				pq.push(make_tuple(currentX, currentY + 1, currentCost + 1, distance(currentX, currentY + 1, goalX, goalY)));
-				path[currentY + 1][currentX] = make_tuple(currentX, currentY, currentCost + 1);
-			}
-		}
-
-		if (!isSolid(levelData[currentY - 1][currentX])
-			&& entityPositionData[currentY - 1][currentX] != ENTITY_SKULL
-			&& entityPositionData[currentY - 1][currentX] != ENTITY_DOOR) {
+TileMapMesh mapMesh;
+LevelPreloader levelPreloader;
 
-			if (currentCost + 1 < get<2>(path[currentY - 1][currentX])) {
-				pq.push(make_tuple(currentX, currentY - 1, currentCost + 1, distance(currentX, currentY - 1, goalX, goalY)));
-				path[currentY - 1][currentX] = make_tuple(currentX, currentY, currentCost + 1);
-			}
-		}
+// uploads the tiles of the level that was just loaded
+void drawMap() {
+	mapMesh.Build(levelData, mapWidth, mapHeight, MAP_SPRITE_COUNT_X, MAP_SPRITE_COUNT_Y, MAP_TILE_SIZE, atlas.Region(mapSpriteSheet));
+}
 
-		if (!isSolid(levelData[currentY][currentX + 1])
-			&& entityPositionData[currentY][currentX + 1] != ENTITY_SKULL
-			&& entityPositionData[currentY][currentX + 1] != ENTITY_DOOR) {
+void runMapCommand(int) {
+	program.SetModelMatrix(glm::mat4(1.0f));
+	mapMesh.Draw(program, atlas.texture, mapViewProjection);
+}
 
-			if (currentCost + 1 < get<2>(path[currentY][currentX + 1])) {
-				pq.push(make_tuple(currentX + 1, currentY, currentCost + 1, distance(currentX + 1, currentY, goalX, goalY)));
-				path[currentY][currentX + 1] = make_tuple(currentX, currentY, currentCost + 1);
-			}
-		}
+// only the chunks the camera can see are drawn
+void renderMap(const glm::mat4 &viewProjection) {
+	mapViewProjection = viewProjection;
+	renderQueue.Submit(LAYER_MAP, program.programID, atlas.texture, 0, runMapCommand, 0);
+}
 
-		if (!isSolid(levelData[currentY][currentX - 1])
-			&& entityPositionData[currentY][currentX - 1] != ENTITY_SKULL
-			&& entityPositionData[currentY][currentX - 1] != ENTITY_DOOR) {
+SpriteBatch spriteBatch;
+SpriteInstancer spriteInstancer;
+// set at startup when the context can draw instanced arrays
+bool instancedSprites = false;
 
-			if (currentCost + 1 < get<2>(path[currentY][currentX - 1])) {
-				pq.push(make_tuple(currentX - 1, currentY, currentCost + 1, distance(currentX - 1, currentY, goalX, goalY)));
-				path[currentY][currentX - 1] = make_tuple(currentX, currentY, currentCost + 1);
-			}
-		}
+void addSprite(const Entity& entity, bool flipX) {
+	if (instancedSprites) {
+		spriteInstancer.Add(entity.sprite, entity.position, flipX);
 	}
-
-	if (currentX >= 0 && currentY >= 0) {
-		int prevX = get<0>(path[currentY][currentX]);
-		int prevY = get<1>(path[currentY][currentX]);
-		while (get<0>(path[prevY][prevX]) != -1 || get<1>(path[prevY][prevX]) != -1) {
-			int newX = get<0>(path[currentY][currentX]);
-			int newY = get<1>(path[currentY][currentX]);
-			prevX = get<0>(path[newY][newX]);
-			prevY = get<1>(path[newY][newX]);
-			currentX = newX;
-			currentY = newY;
-		}
-
-		// figure out the direction
-		if (currentX > prevX) {
-			result = DIRECTION_RIGHT;
-		}
-		else if (currentX < prevX) {
-			result = DIRECTION_LEFT;
-		}
-		else if (currentY < prevY) {
-			result = DIRECTION_UP;
-		}
-		else if (currentY > prevY) {
-			result = DIRECTION_DOWN;
-		}
-
+	else {
+		spriteBatch.Add(entity.sprite, entity.position, flipX);
 	}
-	return result;
 }
 
-class Entity {
-public:
-	Entity() {}
-	Entity(glm::vec3 position, glm::vec3 size, bool isStatic, EntityType type, bool faceRight) {
-		this->position = position;
-		this->size = size;
-		this->isStatic = isStatic;
-		this->entityType = type;
-		this->faceRight = faceRight;
+void runSpriteCommand(int) {
+	if (instancedSprites) {
+		spriteInstancer.Flush();
 	}
-
-	void Draw(ShaderProgram &program) {
-		sprite.Draw(program);
+	else {
+		spriteBatch.Flush(program);
 	}
+}
 
-	void Update(float elapsed) {
-		if (!isStatic) {
-			// check which movement is allowed
-			int tileX, tileY;
-			worldToTileCoordinates(position.x, position.y, tileX, tileY);
+// everything on top of the map, one draw call per texture
+void drawEntities(bool withSwords) {
+	spriteBatch.animationTime = animationTime;
+	spriteInstancer.animationTime = animationTime;
 
-			if (isSolid(levelData[tileY][tileX + 1]) 
-				|| entityPositionData[tileY][tileX + 1] == ENTITY_DOOR
-				|| entityPositionData[tileY][tileX + 1] == ENTITY_SKULL) {
-				rightBlocked = true;
-			}
-			else {
-				rightBlocked = false;
-			}
-			if (isSolid(levelData[tileY][tileX - 1])
-				|| entityPositionData[tileY][tileX - 1] == ENTITY_DOOR
-				|| entityPositionData[tileY][tileX - 1] == ENTITY_SKULL) {
-				leftBlocked = true;
-			}
-			else {
-				leftBlocked = false;
-			}
-			if (isSolid(levelData[tileY - 1][tileX])
-				|| entityPositionData[tileY - 1][tileX] == ENTITY_DOOR
-				|| entityPositionData[tileY - 1][tileX] == ENTITY_SKULL) {
-				upBlocked = true;
-			}
-			else {
-				upBlocked = false;
-			}
-			if (isSolid(levelData[tileY + 1][tileX])
-				|| entityPositionData[tileY + 1][tileX] == ENTITY_DOOR
-				|| entityPositionData[tileY + 1][tileX] == ENTITY_SKULL) {
-				downBlocked = true;
-			}
-			else {
-				downBlocked = false;
-			}
-
-			if (entityType == ENTITY_SKULL && currentState == ENTITY_IDLE) {
-				// check if player is in line of sight
-				queue<pair<int, int>> lineOfSight;
-				// check immediate surrounding (1 tile in each cardinal direction)
-				lineOfSight.push(pair<int, int>(tileY, tileX + 1));
-				lineOfSight.push(pair<int, int>(tileY, tileX - 1));
-				lineOfSight.push(pair<int, int>(tileY + 1, tileX));
-				lineOfSight.push(pair<int, int>(tileY - 1, tileX));
-
-				// change entity state to chasing if player is in line of sight
-				while (!lineOfSight.empty()) {
-					int checkY = lineOfSight.front().first;
-					int checkX = lineOfSight.front().second;
-
-					if (entityPositionData[checkY][checkX] == ENTITY_PLAYER) {
-						currentState = ENTITY_CHASE;
-						break;
-					}
-					if (!isSolid(levelData[checkY][checkX])) {
-						// check next neighbor if current distance from original position is less than 2
-						if (abs(tileY - checkY) + abs(tileX - checkX) < 2) {
-							if (tileY != checkY || tileX != checkX) {
-							lineOfSight.push(pair<int, int>(checkY, checkX + 1));
-							lineOfSight.push(pair<int, int>(checkY, checkX - 1));
-							lineOfSight.push(pair<int, int>(checkY + 1, checkX));
-							lineOfSight.push(pair<int, int>(checkY - 1, checkX));
-							}
-						}
-					}
-					lineOfSight.pop();
-				}
-			}
-		}
+	for (Entity& torch : torches) {
+		addSprite(torch, !torch.faceRight);
 	}
-
-	void clearPositionData() {
-		int tileX, tileY;
-		worldToTileCoordinates(position.x, position.y, tileX, tileY);
-		entityPositionData[tileY][tileX] = ENTITY_NONE;
-	};
-	void setPositionData() {
-		int tileX, tileY;
-		worldToTileCoordinates(position.x, position.y, tileX, tileY);
-		entityPositionData[tileY][tileX] = entityType;
-	};
-
-	// basic movement AI for non static enemy only
-	void Move(glm::vec3 playerPosition) {
-		Direction next = DIRECTION_NONE;
-		if (currentState == ENTITY_CHASE) {
-			// move towards the player
-			int playerTileX, playerTileY, thisTileX, thisTileY;
-			worldToTileCoordinates(playerPosition.x, playerPosition.y, playerTileX, playerTileY);
-			worldToTileCoordinates(position.x, position.y, thisTileX, thisTileY);
-
-			// A* search is not really necessary since skull only sees player if within 2 tile distance
-			// and the walls are at least 2 tiles wide
-			next = aStarSearch(thisTileX, thisTileY, playerTileX, playerTileY);
-
-			clearPositionData();
-			// make the move
-			if (next == DIRECTION_LEFT) {
-				position.x -= MAP_TILE_SIZE;
-				faceRight = false;
-			}
-			else if (next == DIRECTION_RIGHT) {
-				position.x += MAP_TILE_SIZE;
-				faceRight = true;
-			}
-			else if (next == DIRECTION_UP) {
-				position.y += MAP_TILE_SIZE;
-			}
-			else if (next == DIRECTION_DOWN) {
-				position.y -= MAP_TILE_SIZE;
-			}
-			setPositionData();
-		}
-		else if (currentState == ENTITY_IDLE || next == DIRECTION_NONE) {
-			int tileX, tileY;
-			worldToTileCoordinates(position.x, position.y, tileX, tileY);
-
-			// pick a random nonblocked direction and move that way
-			vector<string> potentialDirections;
-			if (!(isSolid(levelData[tileY][tileX - 1])
-				|| entityPositionData[tileY][tileX - 1] == ENTITY_DOOR
-				|| entityPositionData[tileY][tileX - 1] == ENTITY_SKULL)) {
-				potentialDirections.push_back("left"); 
-			}
-			if (!(isSolid(levelData[tileY][tileX + 1])
-				|| entityPositionData[tileY][tileX + 1] == ENTITY_DOOR
-				|| entityPositionData[tileY][tileX + 1] == ENTITY_SKULL)) {
-				potentialDirections.push_back("right");
-			}
-			if (!(isSolid(levelData[tileY - 1][tileX])
-				|| entityPositionData[tileY - 1][tileX] == ENTITY_DOOR
-				|| entityPositionData[tileY - 1][tileX] == ENTITY_SKULL)) {
-				potentialDirections.push_back("up");
-			}
-			if (!(isSolid(levelData[tileY + 1][tileX])
-				|| entityPositionData[tileY + 1][tileX] == ENTITY_DOOR
-				|| entityPositionData[tileY + 1][tileX] == ENTITY_SKULL)) {
-				potentialDirections.push_back("down");
-			}
-
-			if (potentialDirections.empty()) {
-				// no movement if no moves available
-				return;
-			}
-
-			int randomMove = rand() % potentialDirections.size();
-			
-			clearPositionData();
-			// make the move
-			if (potentialDirections[randomMove] == "left") {
-				position.x -= MAP_TILE_SIZE;
-				faceRight = false;
-			}
-			else if (potentialDirections[randomMove] == "right") {
-				position.x += MAP_TILE_SIZE;
-				faceRight = true;
-			}
-			else if (potentialDirections[randomMove] == "up") {
-				position.y += MAP_TILE_SIZE;
-			}
-			else if (potentialDirections[randomMove] == "down") {
-				position.y -= MAP_TILE_SIZE;
-			}
-			setPositionData();
-		}
+	for (Entity& key : keysVector) {
+		addSprite(key, false);
 	}
-
-	bool placeKey(Direction d);
-	bool attack(Direction d);
-
-	bool collided(Entity& other) {
-		// just check if occupying the same tile
-		int thisTileX, thisTileY, otherTileX, otherTileY;
-		worldToTileCoordinates(position.x, position.y, thisTileX, thisTileY);
-		worldToTileCoordinates(other.position.x, other.position.y, otherTileX, otherTileY);
-
-		return ((thisTileX == otherTileX) && (thisTileY == otherTileY));
+	for (Entity& door : doors) {
+		addSprite(door, !door.faceRight);
 	}
-
-	SheetSprite sprite;
-
-	glm::vec3 position;
-	glm::vec3 size;
-
-	bool isStatic;
-	EntityType entityType;
-
-	bool faceRight;
-
-	bool leftBlocked = false;
-	bool rightBlocked = false;
-	bool upBlocked = false;
-	bool downBlocked = false;
-
-	int timeRemaining = 2; // for sword entity only
-	
-	EntityState currentState = ENTITY_IDLE;
-};
-
-Entity player;
-vector<Entity> enemies;
-vector<Entity> torches;
-vector<Entity> keysVector;
-vector<Entity> doors;
-Entity exitLadder;
-vector<Entity> swords;
-
-bool Entity::placeKey(Direction d) {
-	if (keyCount > 0) {
-		int tileX, tileY;
-		worldToTileCoordinates(position.x, position.y, tileX, tileY);
-
-		switch (d) {
-		case DIRECTION_UP:
-			if (entityPositionData[tileY - 1][tileX] == ENTITY_DOOR) {
-				keysVector.push_back(Entity(glm::vec3(position.x, position.y + MAP_TILE_SIZE, 1),
-					glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_KEY, true));
-				keyCount--;
-				return true;
-			}
-			break;
-		case DIRECTION_DOWN:
-			if (entityPositionData[tileY + 1][tileX] == ENTITY_DOOR) {
-				keysVector.push_back(Entity(glm::vec3(position.x, position.y - MAP_TILE_SIZE, 1),
-					glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_KEY, true));
-				keyCount--;
-				return true;
-			}
-			break;
-		case DIRECTION_LEFT:
-			if (entityPositionData[tileY][tileX - 1] == ENTITY_DOOR) {
-				keysVector.push_back(Entity(glm::vec3(position.x - MAP_TILE_SIZE, position.y, 1),
-					glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_KEY, true));
-				keyCount--;
-				return true;
-			}
-			break;
-		case DIRECTION_RIGHT:
-			if (entityPositionData[tileY][tileX + 1] == ENTITY_DOOR) {
-				keysVector.push_back(Entity(glm::vec3(position.x + MAP_TILE_SIZE, position.y, 1),
-					glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_KEY, true));
-				keyCount--;
-				return true;
-			}
-			break;
-		}
+	addSprite(exitLadder, false);
+	addSprite(player, !player.faceRight);
+	for (Entity& enemy : enemies) {
+		addSprite(enemy, !enemy.faceRight);
 	}
-	return false;
-}
-
-bool Entity::attack(Direction d) {
-	int tileX, tileY;
-	worldToTileCoordinates(position.x, position.y, tileX, tileY);
-
-	switch (d) {
-	case DIRECTION_UP:
-		if (entityPositionData[tileY - 1][tileX] == ENTITY_SKULL) {
-			swords.push_back(Entity(glm::vec3(position.x, position.y + MAP_TILE_SIZE, 1),
-				glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_SWORD, true));
-			swords[swords.size() - 1].sprite = SheetSprite(swordSprite, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f);
-			return true;
+	if (withSwords) {
+		for (Entity& sword : swords) {
+			addSprite(sword, !sword.faceRight);
 		}
-		break;
-	case DIRECTION_DOWN:
-		if (entityPositionData[tileY + 1][tileX] == ENTITY_SKULL) {
-			swords.push_back(Entity(glm::vec3(position.x, position.y - MAP_TILE_SIZE, 1),
-				glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_SWORD, true));
-			swords[swords.size() - 1].sprite = SheetSprite(swordSprite, 0.5f, 0.0f, 0.25f, 1.0f, 0.10f);
-			return true;
-		}
-		break;
-	case DIRECTION_LEFT:
-		if (entityPositionData[tileY][tileX - 1] == ENTITY_SKULL) {
-			swords.push_back(Entity(glm::vec3(position.x - MAP_TILE_SIZE, position.y, 1),
-				glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_SWORD, true));
-			swords[swords.size() - 1].sprite = SheetSprite(swordSprite, 0.75f, 0.0f, 0.25f, 1.0f, 0.10f);
-			return true;
-		}
-		break;
-	case DIRECTION_RIGHT:
-		if (entityPositionData[tileY][tileX + 1] == ENTITY_SKULL) {
-			swords.push_back(Entity(glm::vec3(position.x + MAP_TILE_SIZE, position.y, 1),
-				glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_SWORD, true));
-			swords[swords.size() - 1].sprite = SheetSprite(swordSprite, 0.25f, 0.0f, 0.25f, 1.0f, 0.10f);
-			return true;
-		}
-		break;
 	}
-	return false;
-}
 
-vector<float> vertexData;
-vector<float> texCoordData;
-void drawMap() {
-	int levelHeight = LEVEL_1_HEIGHT;
-	int levelWidth = LEVEL_1_WIDTH;
-	if (currentLevel == 2) {
-		levelHeight = LEVEL_2_HEIGHT;
-		levelWidth = LEVEL_2_WIDTH;
-	}
-	else if (currentLevel == 3) {
-		levelHeight = LEVEL_3_HEIGHT;
-		levelWidth = LEVEL_3_WIDTH;
-	}
-	for (int y = 0; y < levelHeight; y++) {
-		for (int x = 0; x < levelWidth; x++) {
-			if (levelData[y][x] != 0) {
-				float u = (float)(((int)levelData[y][x]) % MAP_SPRITE_COUNT_X) / (float)MAP_SPRITE_COUNT_X;
-				float v = (float)(((int)levelData[y][x]) / MAP_SPRITE_COUNT_X) / (float)MAP_SPRITE_COUNT_Y;
-
-				float spriteWidth = 1.0f / (float)MAP_SPRITE_COUNT_X;
-				float spriteHeight = 1.0f / (float)MAP_SPRITE_COUNT_Y;
-
-				vertexData.insert(vertexData.end(), {
-					MAP_TILE_SIZE * x, -MAP_TILE_SIZE * y,
-					MAP_TILE_SIZE * x, (-MAP_TILE_SIZE * y) - MAP_TILE_SIZE,
-					(MAP_TILE_SIZE * x) + MAP_TILE_SIZE, (-MAP_TILE_SIZE * y) - MAP_TILE_SIZE,
-
-					MAP_TILE_SIZE * x, -MAP_TILE_SIZE * y,
-					(MAP_TILE_SIZE * x) + MAP_TILE_SIZE, (-MAP_TILE_SIZE * y) - MAP_TILE_SIZE,
-					(MAP_TILE_SIZE * x) + MAP_TILE_SIZE, -MAP_TILE_SIZE * y
-					});
-
-				texCoordData.insert(texCoordData.end(), {
-					u, v,
-					u, v + (spriteHeight),
-					u + spriteWidth, v + (spriteHeight),
-					u, v,
-					u + spriteWidth, v + (spriteHeight),
-					u + spriteWidth, v
-					});
-			}
-		}
-	}
+	GLuint spriteProgram = instancedSprites ? spriteInstancer.ProgramID() : program.programID;
+	renderQueue.Submit(LAYER_ENTITIES, spriteProgram, atlas.texture, 0, runSpriteCommand, 0);
 }
 
-void renderMap() {
-	glUseProgram(program.programID);
-	glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 0, vertexData.data());
-	glEnableVertexAttribArray(program.positionAttribute);
-	glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoordData.data());
-	glEnableVertexAttribArray(program.texCoordAttribute);
-
-	modelMatrix = glm::mat4(1.0f);
-	program.SetModelMatrix(modelMatrix);
-
-	glBindTexture(GL_TEXTURE_2D, mapSpriteSheet);
-	glDrawArrays(GL_TRIANGLES, 0, vertexData.size() / 2);
-	glDisableVertexAttribArray(program.positionAttribute);
-	glDisableVertexAttribArray(program.texCoordAttribute);
+void runFadeCommand(int) {
+	static const float fadeOutVertices[] = { -1.777f, 1.0f, -1.777f, -1.0f, 1.777f, -1.0f,
+		-1.777f, 1.0f, 1.777f, -1.0f, 1.777f, 1.0f };
+
+	untexturedProgram.SetModelMatrix(glm::translate(glm::mat4(1.0f), fadeCenter));
+	untexturedProgram.SetColor(0.0f, 0.0f, 0.0f, fadeAlpha);
+	glVertexAttribPointer(untexturedProgram.positionAttribute, 2, GL_FLOAT, false, 0, fadeOutVertices);
+	glEnableVertexAttribArray(untexturedProgram.positionAttribute);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	CountDraw(6);
+	glDisableVertexAttribArray(untexturedProgram.positionAttribute);
 }
 
-bool readHeader(std::ifstream &stream) {
-	string line;
-	mapWidth = -1;
-	mapHeight = -1;
-	while (getline(stream, line)) {
-		if (line == "") { break; }
-
-		istringstream sStream(line);
-		string key, value;
-		getline(sStream, key, '=');
-		getline(sStream, value);
+// darkens the screen around center, over the entities and under the text
+void drawFade(const glm::vec3 &center, float alpha) {
+	fadeCenter = center;
+	fadeAlpha = alpha;
+	renderQueue.Submit(LAYER_OVERLAY, untexturedProgram.programID, 0, 0, runFadeCommand, 0);
+}
 
-		if (key == "width") {
-			mapWidth = atoi(value.c_str());
+// seconds until something on screen changes without any input
+float timeUntilNextFrame(bool movementKeyHeld, float currentMovementDelay) {
+	switch (state) {
+	case STATE_GAME: {
+		// the next sprite frame, the next enemy step or the next move of a held key, whichever is first
+		// sprites follow animationTime, the enemies follow animationElapsed which restarts every step
+		float nextFrame = (floorf(animationTime * framesPerSecond) + 1.0f) / framesPerSecond;
+		float wait = nextFrame - animationTime - accumulator;
+		float enemyStep = 1.0f / framesPerSecond - animationElapsed - accumulator;
+		if (enemyStep < wait) {
+			wait = enemyStep;
 		}
-		else if (key == "height") {
-			mapHeight = atoi(value.c_str());
+		if (movementKeyHeld && currentMovementDelay - accumulator < wait) {
+			wait = currentMovementDelay - accumulator;
 		}
+		return wait;
 	}
-
-	if (mapWidth == -1 || mapHeight == -1) {
-		return false;
-	}
-	else { // allocate our map data
-		levelData = new short*[mapHeight];
-		entityPositionData = new EntityType*[mapHeight];
-		for (int i = 0; i < mapHeight; ++i) {
-			levelData[i] = new short[mapWidth];
-			entityPositionData[i] = new EntityType[mapWidth];
-		}
-		return true;
+	case STATE_GAMEOVER:
+		return fadeout < FADEOUT_TIME ? 0.0f : IDLE_WAIT;
+	default:
+		return IDLE_WAIT;
 	}
 }
 
-bool readLayerData(std::ifstream &stream) {
-	string line;
-	while (getline(stream, line)) {
-		if (line == "") { break; }
-		istringstream sStream(line);
-		string key, value;
-		getline(sStream, key, '=');
-		getline(sStream, value);
-		if (key == "data") {
-			for (int y = 0; y < mapHeight; y++) {
-				getline(stream, line);
-				istringstream lineStream(line);
-				string tile;
-
-				for (int x = 0; x < mapWidth; x++) {
-					getline(lineStream, tile, ',');
-					unsigned char val = (unsigned char)atoi(tile.c_str());
-					if (val > 0) {
-						// be careful, the tiles in this format are indexed from 1 not 0
-						levelData[y][x] = val - 1;
-					}
-					else {
-						levelData[y][x] = 0;
-					}
-					entityPositionData[y][x] = ENTITY_NONE;
-				}
-			}
-		}
+// plays whatever the last turn asked for
+void playEventSounds() {
+	if (!soundsLoaded) {
+		gameEvents = GameEvents();
+		return;
 	}
-	return true;
-}
-
-void placeEntity(const string& type, float x, float y) {
-	if (type == "Player") {
-		player = Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), false, ENTITY_PLAYER, true);
-		player.sprite = SheetSprite(playerSpriteSheet, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f);
+	if (gameEvents.hitWall) {
+		Mix_PlayChannel(-1, hit_wall, 0);
 	}
-	else if (type == "Skull") {
-		enemies.push_back(Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), false, ENTITY_SKULL, false));
-		enemies[enemies.size() - 1].sprite = SheetSprite(skullSpriteSheet, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f);
+	if (gameEvents.swordSwung) {
+		Mix_PlayChannel(-1, swordSound, 0);
 	}
-	else if (type == "Torch") {
-		torches.push_back(Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_TORCH, true));
-		torches[torches.size() - 1].sprite = SheetSprite(torchSpriteSheet, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f);
+	if (gameEvents.keyPickedUp) {
+		Mix_PlayChannel(-1, keySound, 0);
 	}
-	else if (type == "Side_Torch") {
-		torches.push_back(Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_SIDE_TORCH, true));
-		torches[torches.size() - 1].sprite = SheetSprite(sideTorchSpriteSheet, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f);
+	if (gameEvents.doorOpened) {
+		Mix_PlayChannel(-1, doorSound, 0);
 	}
-	else if (type == "Key") {
-		keysVector.push_back(Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_KEY, true));
-		keysVector[keysVector.size() - 1].sprite = SheetSprite(keySpriteSheet, 0.0f, 0.0f, 0.25f, 1.0f, 0.10f);
-	}
-	else if (type == "Door") {
-		doors.push_back(Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_DOOR, true));
-		doors[doors.size() - 1].sprite = SheetSprite(mapSpriteSheet, 0.6f, 0.4f, 0.1f, 0.1f, 0.10f);
-	}
-	else if (type == "Exit") {
-		exitLadder = Entity(glm::vec3(x, y, 1), glm::vec3(MAP_TILE_SIZE, MAP_TILE_SIZE, 1), true, ENTITY_EXIT, true);
-		exitLadder.sprite = SheetSprite(mapSpriteSheet, 0.9f, 0.3f, 0.1f, 0.1f, 0.10f);
-	}
-}
-
-bool readEntityData(std::ifstream &stream) {
-	string line;
-	string type;
-
-	while (getline(stream, line)) {
-		if (line == "") { break; }
-
-		istringstream sStream(line);
-		string key, value;
-		getline(sStream, key, '=');
-		getline(sStream, value);
-
-		if (key == "type") {
-			type = value;
-		}
-		else if (key == "location") {
-			istringstream lineStream(value);
-			string xPosition, yPosition;
-			getline(lineStream, xPosition, ',');
-			getline(lineStream, yPosition, ',');
-
-			float placeX = atoi(xPosition.c_str())*MAP_TILE_SIZE + MAP_TILE_SIZE / 2;
-			float placeY = atoi(yPosition.c_str())*-MAP_TILE_SIZE + MAP_TILE_SIZE / 2;
-			placeEntity(type, placeX, placeY);
-
-			int tileX, tileY;
-			worldToTileCoordinates(placeX, placeY, tileX, tileY);
-			if (type == "Player") {
-				entityPositionData[tileY][tileX] = ENTITY_PLAYER;
-			}
-			else if (type == "Skull") {
-				entityPositionData[tileY][tileX] = ENTITY_SKULL;
-			}
-			else if (type == "Door") {
-				entityPositionData[tileY][tileX] = ENTITY_DOOR;
-			}
-		}
-	}
-	return true;
+	gameEvents = GameEvents();
 }
 
-void setupScene(const string& mapFile) {
-	ifstream infile(mapFile);
-	string line;
-	while (getline(infile, line)) {
-		if (line == "[header]") {
-			if (!readHeader(infile))
-				return;
+int main(int argc, char *argv[])
+{
+	startupCounter = SDL_GetPerformanceCounter();
+
+	// redraws only when something changed unless --continuous asks for the old busy loop
+	// --serial-assets loads everything on this thread before the first frame, for comparison
+	// --path astar|jps|flow|incremental|hierarchical picks how skulls chase, the shared flow field by default
+	bool renderOnChange = true;
+	bool serialAssets = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--continuous") == 0) {
+			renderOnChange = false;
 		}
-		else if (line == "[layer]") {
-			readLayerData(infile);
+		else if (strcmp(argv[i], "--serial-assets") == 0) {
+			serialAssets = true;
 		}
-		else if (line == "[Entity]") {
-			readEntityData(infile);
+		else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) {
+			if (!pathModeFromName(argv[++i], pathMode)) {
+				SDL_Log("unknown path mode %s, using the flow field", argv[i]);
+			}
 		}
 	}
 
-	drawMap();
-}
-
-int main(int argc, char *argv[])
-{
 	SDL_Init(SDL_INIT_VIDEO);
 	displayWindow = SDL_CreateWindow("Some Game", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 640, 360, SDL_WINDOW_OPENGL);
 	SDL_GLContext context = SDL_GL_CreateContext(displayWindow);
@@ -885,25 +327,32 @@ int main(int argc, char *argv[])
 	glewInit();
 #endif
 
-	// textures
-	font = LoadTexture(RESOURCE_FOLDER"font1.png");
-	playerSpriteSheet = LoadTexture(RESOURCE_FOLDER"priest2_framesheet.png");
-	skullSpriteSheet = LoadTexture(RESOURCE_FOLDER"skull_framesheet.png");
-	torchSpriteSheet = LoadTexture(RESOURCE_FOLDER"torch_framesheet.png");
-	sideTorchSpriteSheet = LoadTexture(RESOURCE_FOLDER"side_torch_framesheet.png");
-	keySpriteSheet = LoadTexture(RESOURCE_FOLDER"key_framesheet.png");
-	mapSpriteSheet = LoadTexture(RESOURCE_FOLDER"Dungeon_Tileset.png");
-	swordSprite = LoadTexture(RESOURCE_FOLDER"sword.png");
-
-	// sounds
+	unsigned int loaderThreads = serialAssets ? 0 : std::max(1u, std::thread::hardware_concurrency());
+
+	// sounds, the title screen does not wait for them
+	// SDL_mixer does not promise its loaders can run at once, so they get one thread to themselves
 	Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 4096);
-	hit_wall = Mix_LoadWAV(RESOURCE_FOLDER"hit_wall.wav");
-	keySound = Mix_LoadWAV(RESOURCE_FOLDER"key.wav");
-	doorSound = Mix_LoadWAV(RESOURCE_FOLDER"door.wav");
-	swordSound = Mix_LoadWAV(RESOURCE_FOLDER"sword.wav");
-	bgm = Mix_LoadMUS(RESOURCE_FOLDER"TRG_Banks_Christmas_Town.mp3");
-	Mix_VolumeMusic(20);
-	Mix_PlayMusic(bgm, -1);
+	for (int i = 0; i < (int)(sizeof(soundAssets) / sizeof(soundAssets[0])); i++) {
+		soundLoader.Add(loadSound, i);
+	}
+	soundLoader.Add(loadMusic, 0);
+	soundLoader.Start(serialAssets ? 0 : 1);
+
+	// textures, the font shares the atlas with the sprite sheets so all of them are needed
+	font = loadImage(RESOURCE_FOLDER"font1.png");
+	playerSpriteSheet = loadImage(RESOURCE_FOLDER"priest2_framesheet.png");
+	skullSpriteSheet = loadImage(RESOURCE_FOLDER"skull_framesheet.png");
+	torchSpriteSheet = loadImage(RESOURCE_FOLDER"torch_framesheet.png");
+	sideTorchSpriteSheet = loadImage(RESOURCE_FOLDER"side_torch_framesheet.png");
+	keySpriteSheet = loadImage(RESOURCE_FOLDER"key_framesheet.png");
+	mapSpriteSheet = loadImage(RESOURCE_FOLDER"Dungeon_Tileset.png");
+	swordSprite = loadImage(RESOURCE_FOLDER"sword.png");
+	imageLoader.Start(loaderThreads);
+	imageLoader.Wait();
+	float imagesDecoded = startupMilliseconds();
+	atlas.Build();
+	spriteBatch.atlas = &atlas;
+	float atlasUploaded = startupMilliseconds();
 
 	state = STATE_TITLE;
 
@@ -916,23 +365,60 @@ int main(int argc, char *argv[])
 
 	projectionMatrix = glm::ortho(-1.777f, 1.777f, -1.0f, 1.0f, -1.0f, 1.0f);
 
-	ShaderProgram untexturedProgram;
 	untexturedProgram.Load(RESOURCE_FOLDER"vertex.glsl", RESOURCE_FOLDER"fragment.glsl");
 
 	program.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
-	program.SetProjectionMatrix(projectionMatrix);
-	program.SetViewMatrix(viewMatrix);
-	glUseProgram(program.programID);
+	// one camera for every program
+	ShaderProgram::SetProjectionMatrix(projectionMatrix);
+	ShaderProgram::SetViewMatrix(viewMatrix);
+
+	instancedSprites = spriteInstancer.Init(RESOURCE_FOLDER"vertex_instanced.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
+	spriteInstancer.atlas = &atlas;
+	program.Use();
 
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	float shadersLoaded = startupMilliseconds();
+	bool firstFrame = true;
 
 	float currentMovementDelay = 0.0f;
+	float statsElapsed = 0.0f;
+
+	// what the last presented frame showed, the loop only sleeps while that is still current
+	bool presented = false;
+	GameState drawnState = state;
 
 	SDL_Event event;
 	bool done = false;
 	while (!done) {
 		const Uint8 *keys = SDL_GetKeyboardState(NULL);
+
+		// block until input arrives or the next change is due, the event stays queued for the poll below
+		if (renderOnChange) {
+			float wait = 0.0f;
+			float sinceLastFrame = (float)SDL_GetTicks() / 1000.0f - lastFrameTicks;
+			if (!presented) {
+				// the fixed update skipped the last frame, it needs one full step
+				wait = FIXED_TIMESTEP - accumulator - sinceLastFrame;
+			}
+			else if (state == drawnState) {
+				bool movementKeyHeld = keys[SDL_SCANCODE_LEFT] || keys[SDL_SCANCODE_RIGHT] || keys[SDL_SCANCODE_UP] || keys[SDL_SCANCODE_DOWN];
+				wait = timeUntilNextFrame(movementKeyHeld, currentMovementDelay) - sinceLastFrame;
+			}
+			if (wait > 0.0f) {
+				SDL_WaitEventTimeout(NULL, (int)(wait * 1000.0f) + 1);
+			}
+		}
+		presented = false;
+
+		// music starts once the loader threads are done with the sound globals
+		if (!soundsLoaded && soundLoader.Finished()) {
+			soundLoader.Wait();
+			soundsLoaded = true;
+			Mix_VolumeMusic(20);
+			Mix_PlayMusic(bgm, -1);
+			SDL_Log("startup: sounds ready at %.1f ms", startupMilliseconds());
+		}
 		while (SDL_PollEvent(&event)) {
 			if (event.type == SDL_QUIT || event.type == SDL_WINDOWEVENT_CLOSE) {
 				done = true;
@@ -943,60 +429,48 @@ int main(int argc, char *argv[])
 			}
 			if (state == STATE_TITLE) {
 				if (keys[SDL_SCANCODE_SPACE]) {
-					// clear out the vectors
-					enemies.clear();
-					torches.clear();
-					keysVector.clear();
-					doors.clear();
-					swords.clear();
 					keyCount = 0;
-
-					// clear out vertex and texcoord data
-					vertexData.clear();
-					texCoordData.clear();
-
 					currentLevel = 1;
-					setupScene("level1.txt");
+					if (!setupScene("level1.txt")) {
+						gameOverMessage = "Could not load level1.txt";
+						state = STATE_GAMEOVER;
+					}
+					else {
+						drawMap();
+						fadeout = 0.0f;
 
-					// center camera on the player
-					viewMatrix = glm::mat4(1.0f);
-					viewMatrix = glm::scale(viewMatrix, glm::vec3(2.0f, 2.0f, 1.0f));
-					viewMatrix = glm::translate(viewMatrix, -player.position);
-					program.SetViewMatrix(viewMatrix);
+						// center camera on the player
+						viewMatrix = glm::mat4(1.0f);
+						viewMatrix = glm::scale(viewMatrix, glm::vec3(2.0f, 2.0f, 1.0f));
+						viewMatrix = glm::translate(viewMatrix, -player.position);
+						ShaderProgram::SetViewMatrix(viewMatrix);
 
-					state = STATE_GAME;
+						state = STATE_GAME;
+					}
 				}
 			}
 			else if (state == STATE_NEXT_LEVEL) {
 				if (keys[SDL_SCANCODE_SPACE]) {
-					// clear out the vectors
-					enemies.clear();
-					torches.clear();
-					keysVector.clear();
-					doors.clear();
-					swords.clear();
-
-					// clear out vertex and texcoord data
-					vertexData.clear();
-					texCoordData.clear();
-
-					currentLevel++;
-					if (currentLevel == 2) {
-						setupScene("level2.txt");
-					}
-					else if (currentLevel == 3) {
-						setupScene("level3.txt");
+					// loaded behind the level complete screen, this only waits if it is not done yet
+					if (!levelPreloader.Finish()) {
+						gameOverMessage = "Could not load the next level";
+						state = STATE_GAMEOVER;
 					}
+					else {
+						currentLevel++;
+						fadeout = 0.0f;
 
-					// center camera on the player
-					viewMatrix = glm::mat4(1.0f);
-					viewMatrix = glm::scale(viewMatrix, glm::vec3(2.0f, 2.0f, 1.0f));
-					viewMatrix = glm::translate(viewMatrix, -player.position);
-					program.SetViewMatrix(viewMatrix);
+						// center camera on the player
+						viewMatrix = glm::mat4(1.0f);
+						viewMatrix = glm::scale(viewMatrix, glm::vec3(2.0f, 2.0f, 1.0f));
+						viewMatrix = glm::translate(viewMatrix, -player.position);
+						ShaderProgram::SetViewMatrix(viewMatrix);
 
-					state = STATE_GAME;
+						state = STATE_GAME;
+					}
 				}
 				if (keys[SDL_SCANCODE_ESCAPE]) {
+					levelPreloader.Cancel();
 					state = STATE_TITLE;
 					int currentLevel = 1;
 					int keyCount = 0;
@@ -1009,151 +483,73 @@ int main(int argc, char *argv[])
 			}
 		}
 		glClear(GL_COLOR_BUFFER_BIT);
+		renderQueue.Clear();
+		textDraws.clear();
+		textStorage.clear();
 
 		float ticks = (float)SDL_GetTicks() / 1000.0f;
 		float elapsed = ticks - lastFrameTicks;
 		lastFrameTicks = ticks;
 
 		// GAME STATE
+		GameState frameState = state;
 		switch (state) {
 		case STATE_TITLE:
 			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-			program.SetViewMatrix(glm::mat4(1.0f));
+			ShaderProgram::SetViewMatrix(glm::mat4(1.0f));
 
 			modelMatrix = glm::mat4(1.0f);
 			modelMatrix = glm::translate(modelMatrix, glm::vec3(-0.8f, 0.4f, 0.0f));
-			program.SetModelMatrix(modelMatrix);
-			DrawText(program, font, "Some Game", 0.2f, 0);
+			DrawText(program, font, modelMatrix, "Some Game", 0.2f, 0);
 
 			modelMatrix = glm::mat4(1.0f);
 			modelMatrix = glm::translate(modelMatrix, glm::vec3(-0.95f, -0.3f, 0.0f));
-			program.SetModelMatrix(modelMatrix);
-			DrawText(program, font, "Press Space to Start", 0.1f, 0);
+			DrawText(program, font, modelMatrix, "Press Space to Start", 0.1f, 0);
 
 			break;
 
 		case STATE_NEXT_LEVEL:
 			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-			program.SetViewMatrix(glm::mat4(1.0f));
+			ShaderProgram::SetViewMatrix(glm::mat4(1.0f));
 
 			modelMatrix = glm::mat4(1.0f);
 			modelMatrix = glm::translate(modelMatrix, glm::vec3(-1.5f, 0.2f, 0.0f));
-			program.SetModelMatrix(modelMatrix);
-			DrawText(program, font, "Level " + to_string(currentLevel) + " Complete", 0.2f, 0);
+			char levelText[32];
+			snprintf(levelText, sizeof(levelText), "Level %d Complete", currentLevel);
+			DrawText(program, font, modelMatrix, levelText, 0.2f, 0);
 
 			modelMatrix = glm::mat4(1.0f);
 			modelMatrix = glm::translate(modelMatrix, glm::vec3(-0.75f, -0.1f, 0.0f));
-			program.SetModelMatrix(modelMatrix);
-			DrawText(program, font, "Space : Continue", 0.1f, 0);
+			DrawText(program, font, modelMatrix, "Space : Continue", 0.1f, 0);
 
 			modelMatrix = glm::mat4(1.0f);
 			modelMatrix = glm::translate(modelMatrix, glm::vec3(-1.215f, -0.4f, 0.0f));
-			program.SetModelMatrix(modelMatrix);
-			DrawText(program, font, "ESC : Return to Title Screen", 0.09f, 0);
+			DrawText(program, font, modelMatrix, "ESC : Return to Title Screen", 0.09f, 0);
 
+			// upload the next level as soon as it is parsed rather than when the player continues
+			if (levelPreloader.pending && levelPreloader.Ready()) {
+				levelPreloader.Finish();
+			}
 			break;
 
 		case STATE_GAME:
 			glClearColor(0.1412f, 0.0745f, 0.1020f, 1.0f);
-			renderMap();
-
 			if (currentMovementDelay <= 0 && swords.empty()) {
+				Direction action = DIRECTION_NONE;
 				if (keys[SDL_SCANCODE_LEFT]) {
-					player.faceRight = false;
-					if (!player.leftBlocked) {
-						player.clearPositionData();
-						player.position.x -= MAP_TILE_SIZE;
-						player.setPositionData();
-
-						for (unsigned i = 0; i < enemies.size(); i++) {
-							enemies[i].Move(player.position);
-						}
-					}
-					else {
-						player.placeKey(DIRECTION_LEFT);
-						if (!player.attack(DIRECTION_LEFT)) {
-							Mix_PlayChannel(-1, hit_wall, 0);
-							for (unsigned i = 0; i < enemies.size(); i++) {
-								enemies[i].Move(player.position);
-							}
-						}
-						else {
-							Mix_PlayChannel(-1, swordSound, 0);
-						}
-					}
-					currentMovementDelay = MOVEMENT_DELAY;
+					action = DIRECTION_LEFT;
 				}
 				else if (keys[SDL_SCANCODE_RIGHT]) {
-					player.faceRight = true;
-					if (!player.rightBlocked) {
-						player.clearPositionData();
-						player.position.x += MAP_TILE_SIZE;
-						player.setPositionData();
-
-						for (unsigned i = 0; i < enemies.size(); i++) {
-							enemies[i].Move(player.position);
-						}
-					}
-					else {
-						player.placeKey(DIRECTION_RIGHT);
-						if (!player.attack(DIRECTION_RIGHT)) {
-							Mix_PlayChannel(-1, hit_wall, 0);
-							for (unsigned i = 0; i < enemies.size(); i++) {
-								enemies[i].Move(player.position);
-							}
-						}
-						else {
-							Mix_PlayChannel(-1, swordSound, 0);
-						}
-					}
-					currentMovementDelay = MOVEMENT_DELAY;
+					action = DIRECTION_RIGHT;
 				}
 				else if (keys[SDL_SCANCODE_DOWN]) {
-					if (!player.downBlocked) {
-						player.clearPositionData();
-						player.position.y -= MAP_TILE_SIZE;
-						player.setPositionData();
-
-						for (unsigned i = 0; i < enemies.size(); i++) {
-							enemies[i].Move(player.position);
-						}
-					}
-					else {
-						player.placeKey(DIRECTION_DOWN);
-						if (!player.attack(DIRECTION_DOWN)) {
-							Mix_PlayChannel(-1, hit_wall, 0);
-							for (unsigned i = 0; i < enemies.size(); i++) {
-								enemies[i].Move(player.position);
-							}
-						}
-						else {
-							Mix_PlayChannel(-1, swordSound, 0);
-						}
-					}
-					currentMovementDelay = MOVEMENT_DELAY;
+					action = DIRECTION_DOWN;
 				}
 				else if (keys[SDL_SCANCODE_UP]) {
-					if (!player.upBlocked) {
-						player.clearPositionData();
-						player.position.y += MAP_TILE_SIZE;
-						player.setPositionData();
-
-						for (unsigned i = 0; i < enemies.size(); i++) {
-							enemies[i].Move(player.position);
-						}
-					}
-					else {
-						player.placeKey(DIRECTION_UP);
-						if (!player.attack(DIRECTION_UP)) {
-							Mix_PlayChannel(-1, hit_wall, 0);
-							for (unsigned i = 0; i < enemies.size(); i++) {
-								enemies[i].Move(player.position);
-							}
-						}
-						else {
-							Mix_PlayChannel(-1, swordSound, 0);
-						}
-					}
+					action = DIRECTION_UP;
+				}
+				if (action != DIRECTION_NONE) {
+					playerAction(action);
 					currentMovementDelay = MOVEMENT_DELAY;
 				}
 
@@ -1161,9 +557,12 @@ int main(int argc, char *argv[])
 				viewMatrix = glm::mat4(1.0f);
 				viewMatrix = glm::scale(viewMatrix, glm::vec3(2.0f, 2.0f, 1.0f));
 				viewMatrix = glm::translate(viewMatrix, -player.position);
-				program.SetViewMatrix(viewMatrix);
+				ShaderProgram::SetViewMatrix(viewMatrix);
 			}
 
+			// queued draws run at the end of the frame with this camera
+			renderMap(projectionMatrix * viewMatrix);
+
 			// fixed update
 			elapsed += accumulator;
 			if (elapsed < FIXED_TIMESTEP) {
@@ -1175,29 +574,11 @@ int main(int argc, char *argv[])
 
 				currentMovementDelay -= FIXED_TIMESTEP;
 
-				// animation
+				// animation, the enemies still step on the old frame cadence
+				animationTime += FIXED_TIMESTEP;
 				animationElapsed += FIXED_TIMESTEP;
 				if (animationElapsed > 1.0 / framesPerSecond) {
-					currentIndex++;
-					if (currentIndex > numFrames - 1) {
-						currentIndex = 0;
-					}
-
-					// update all the sprites
-					player.sprite.u = 0.25f * currentIndex;
-					for (unsigned i = 0; i < enemies.size(); i++) {
-						enemies[i].sprite.u = 0.25f * currentIndex;
-						enemies[i].Update(FIXED_TIMESTEP);
-					}
-					for (unsigned i = 0; i < torches.size(); i++) {
-						torches[i].sprite.u = 0.25f * currentIndex;
-					}
-					for (unsigned i = 0; i < keysVector.size(); i++) {
-						keysVector[i].sprite.u = 0.25f * currentIndex;
-					}
-					for (unsigned i = 0; i < swords.size(); i++) {
-						swords[i].timeRemaining--;
-					}
+					animationTick(FIXED_TIMESTEP);
 
 					animationElapsed = 0.0;
 				}
@@ -1206,243 +587,99 @@ int main(int argc, char *argv[])
 			}
 			accumulator = elapsed;
 
-			// draw static entities
-			for (Entity& torch : torches) {
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, torch.position);
-				if (!torch.faceRight) {
-					modelMatrix = glm::scale(modelMatrix, glm::vec3(-1.0f, 1.0f, 1.0f));
-				}
-				program.SetModelMatrix(modelMatrix);
-				torch.Draw(program);
-			}
-
-			for (unsigned i = 0; i < keysVector.size(); i++) {
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, keysVector[i].position);
-				program.SetModelMatrix(modelMatrix);
-				keysVector[i].Draw(program);
-
-				if (keysVector[i].collided(player)) {
-					Mix_PlayChannel(-1, keySound, 0);
-					keysVector.erase(keysVector.begin() + i);
-					keyCount++;
-					i--;
-				}
-				else {
-					for (unsigned j = 0; j < doors.size(); j++) {
-						if (keysVector[i].collided(doors[j])) {
-							Mix_PlayChannel(-1, doorSound, 0);
-							keysVector.erase(keysVector.begin() + i);
-							doors[j].clearPositionData();
-							doors.erase(doors.begin() + j);
-							i--;
-							break;
-						}
-					}
-				}
-			}
+			resolveKeys();
 
-			for (Entity& door : doors) {
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, door.position);
-				if (!door.faceRight) {
-					modelMatrix = glm::scale(modelMatrix, glm::vec3(-1.0f, 1.0f, 1.0f));
-				}
-				program.SetModelMatrix(modelMatrix);
-				door.Draw(program);
-			}
+			drawEntities(true);
 
-			// draw exit
-			modelMatrix = glm::mat4(1.0f);
-			modelMatrix = glm::translate(modelMatrix, exitLadder.position);
-			program.SetModelMatrix(modelMatrix);
-			exitLadder.Draw(program);
-
-			// draw player
-			modelMatrix = glm::mat4(1.0f);
-			modelMatrix = glm::translate(modelMatrix, player.position);
-			if (!player.faceRight) {
-				modelMatrix = glm::scale(modelMatrix, glm::vec3(-1.0f, 1.0f, 1.0f));
-			}
-			program.SetModelMatrix(modelMatrix);
-			player.Draw(program);
-
-			// draw enemies
-			for (Entity& enemy : enemies) {
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, enemy.position);
-				if (!enemy.faceRight) {
-					modelMatrix = glm::scale(modelMatrix, glm::vec3(-1.0f, 1.0f, 1.0f));
-				}
-				if (enemy.collided(player)) {
-					state = STATE_GAMEOVER;
-					fadeout = 0.0f;
-					gameOverMessage = "You Died";
-				}
-				program.SetModelMatrix(modelMatrix);
-				enemy.Draw(program);
-			}
-
-			for (unsigned i = 0; i < swords.size(); i++) {
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, swords[i].position);
-				if (!swords[i].faceRight) {
-					modelMatrix = glm::scale(modelMatrix, glm::vec3(-1.0f, 1.0f, 1.0f));
-				}
-				program.SetModelMatrix(modelMatrix);
-				swords[i].Draw(program);
-
-				if (swords[i].timeRemaining == 0) {
-					for (unsigned j = 0; j < enemies.size(); j++) {
-						if (enemies[j].collided(swords[i])) {
-							enemies[j].clearPositionData();
-							enemies.erase(enemies.begin() + j);
-							swords.erase(swords.begin() + i);
-							i--;
-							break;
-						}
-					}
-
-					for (unsigned i = 0; i < enemies.size(); i++) {
-						enemies[i].Move(player.position);
-					}
-				}
-			}
+			resolveSwords();
+			checkLevelOutcome();
+			playEventSounds();
 
 			modelMatrix = glm::mat4(1.0f);
 			modelMatrix = glm::translate(modelMatrix, player.position);
 			modelMatrix = glm::translate(modelMatrix, glm::vec3(-0.85f, 0.45f, 0.0f));
-			program.SetModelMatrix(modelMatrix);
-			DrawText(program, font, "Keys:" + to_string(keyCount), 0.05f, 0);
+			char keysText[32];
+			snprintf(keysText, sizeof(keysText), "Keys:%d", keyCount);
+			DrawText(program, font, modelMatrix, keysText, 0.05f, 0);
 
 			modelMatrix = glm::mat4(1.0f);
 			modelMatrix = glm::translate(modelMatrix, player.position);
 			modelMatrix = glm::translate(modelMatrix, glm::vec3(0.55f, 0.45f, 0.0f));
-			program.SetModelMatrix(modelMatrix);
-			DrawText(program, font, "Q:Quit", 0.05f, 0);
-
-			if (player.collided(exitLadder)) {
-				if (currentLevel == 3) {
-					state = STATE_GAMEOVER;
-					fadeout = 0.0f;
-					gameOverMessage = "That's all the Levels";
-				}
-				else {
-					state = STATE_NEXT_LEVEL;
-				}
-			}
+			DrawText(program, font, modelMatrix, "Q:Quit", 0.05f, 0);
 
 			break;
 
 		case STATE_GAMEOVER:
 			glClearColor(0.1412f, 0.0745f, 0.1020f, 1.0f);
-			renderMap();
 
 			// center camera on the player
 			viewMatrix = glm::mat4(1.0f);
 			viewMatrix = glm::scale(viewMatrix, glm::vec3(2.0f, 2.0f, 1.0f));
 			viewMatrix = glm::translate(viewMatrix, -player.position);
-			program.SetViewMatrix(viewMatrix);
-
-			// draw static entities
-			for (Entity& torch : torches) {
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, torch.position);
-				if (!torch.faceRight) {
-					modelMatrix = glm::scale(modelMatrix, glm::vec3(-1.0f, 1.0f, 1.0f));
-				}
-				program.SetModelMatrix(modelMatrix);
-				torch.Draw(program);
-			}
-
-			for (unsigned i = 0; i < keysVector.size(); i++) {
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, keysVector[i].position);
-				program.SetModelMatrix(modelMatrix);
-				keysVector[i].Draw(program);
-			}
-
-			for (Entity& door : doors) {
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, door.position);
-				if (!door.faceRight) {
-					modelMatrix = glm::scale(modelMatrix, glm::vec3(-1.0f, 1.0f, 1.0f));
-				}
-				program.SetModelMatrix(modelMatrix);
-				door.Draw(program);
-			}
-
-			// draw exit
-			modelMatrix = glm::mat4(1.0f);
-			modelMatrix = glm::translate(modelMatrix, exitLadder.position);
-			program.SetModelMatrix(modelMatrix);
-			exitLadder.Draw(program);
+			ShaderProgram::SetViewMatrix(viewMatrix);
 
-			// draw player
-			modelMatrix = glm::mat4(1.0f);
-			modelMatrix = glm::translate(modelMatrix, player.position);
-			if (!player.faceRight) {
-				modelMatrix = glm::scale(modelMatrix, glm::vec3(-1.0f, 1.0f, 1.0f));
-			}
-			program.SetModelMatrix(modelMatrix);
-			player.Draw(program);
-
-			// draw enemies
-			for (Entity& enemy : enemies) {
-				modelMatrix = glm::mat4(1.0f);
-				modelMatrix = glm::translate(modelMatrix, enemy.position);
-				if (!enemy.faceRight) {
-					modelMatrix = glm::scale(modelMatrix, glm::vec3(-1.0f, 1.0f, 1.0f));
-				}
-				program.SetModelMatrix(modelMatrix);
-				enemy.Draw(program);
-			}
+			renderMap(projectionMatrix * viewMatrix);
 
-			float fadeOutVertices[] = { -1.777f, 1.0f, -1.777f, -1.0f, 1.777f, -1.0f, 
-				-1.777f, 1.0f, 1.777f, -1.0f, 1.777f, 1.0f};
+			drawEntities(false);
 
 			if (fadeout < FADEOUT_TIME) {
 				fadeout += elapsed;
 			}
 			fadeout = (fadeout < FADEOUT_TIME ? fadeout : FADEOUT_TIME);
 
-			glUseProgram(untexturedProgram.programID);
-			untexturedProgram.SetModelMatrix(glm::translate(glm::mat4(1.0f), player.position));
-			untexturedProgram.SetProjectionMatrix(projectionMatrix);
-			untexturedProgram.SetViewMatrix(viewMatrix);
-			untexturedProgram.SetColor(0.0f, 0.0f, 0.0f, fadeout / FADEOUT_TIME);
-			glVertexAttribPointer(untexturedProgram.positionAttribute, 2, GL_FLOAT, false, 0, fadeOutVertices);
-			glEnableVertexAttribArray(untexturedProgram.positionAttribute);
-			glDrawArrays(GL_TRIANGLES, 0, 6);
-			glDisableVertexAttribArray(untexturedProgram.positionAttribute);
-
-			glUseProgram(program.programID);
+			drawFade(player.position, fadeout / FADEOUT_TIME);
 
 			modelMatrix = glm::mat4(1.0f);
 			modelMatrix = glm::translate(modelMatrix, player.position);
 			modelMatrix = glm::translate(modelMatrix, glm::vec3(-0.4f, 0.1f, 0.0f));
-			program.SetModelMatrix(modelMatrix);
-			DrawText(program, font, "GAME OVER", 0.1f, 0);
+			DrawText(program, font, modelMatrix, "GAME OVER", 0.1f, 0);
 
 			modelMatrix = glm::mat4(1.0f);
 			float fontXPos = -((gameOverMessage.size() - 1) * 0.05f) / 2;
 			modelMatrix = glm::translate(modelMatrix, player.position);
 			modelMatrix = glm::translate(modelMatrix, glm::vec3(fontXPos, -0.1f, 0.0f));
-			program.SetModelMatrix(modelMatrix);
-			DrawText(program, font, gameOverMessage, 0.05f, 0);
+			DrawText(program, font, modelMatrix, gameOverMessage.c_str(), 0.05f, 0);
 
 			modelMatrix = glm::mat4(1.0f);
 			modelMatrix = glm::translate(modelMatrix, player.position);
 			modelMatrix = glm::translate(modelMatrix, glm::vec3(-0.675f, -0.2f, 0.0f));
-			program.SetModelMatrix(modelMatrix);
-			DrawText(program, font, "ESC : Return to Title Screen", 0.05f, 0);
+			DrawText(program, font, modelMatrix, "ESC : Return to Title Screen", 0.05f, 0);
+		}
+
+
+		renderQueue.Execute();
+		textCache.EndFrame();
+
+		// the level complete screen only shows text, so the next level can load behind it once
+		// this frame's map and entities are drawn
+		if (frameState == STATE_GAME && state == STATE_NEXT_LEVEL) {
+			char nextLevel[32];
+			snprintf(nextLevel, sizeof(nextLevel), "level%d.txt", currentLevel + 1);
+			levelPreloader.Start(nextLevel, mapMesh, MAP_SPRITE_COUNT_X, MAP_SPRITE_COUNT_Y, MAP_TILE_SIZE, atlas.Region(mapSpriteSheet));
 		}
 
+		// the last frame's costs in the title bar, refreshed once a second
+		statsElapsed += elapsed;
+		if (statsElapsed >= 1.0f) {
+			char title[128];
+			snprintf(title, sizeof(title), "Some Game - %d draws, %d texture binds, %d program binds, %d vertices, %d commands",
+				renderStats.drawCalls, renderStats.textureBinds, renderStats.programBinds, renderStats.vertices, renderStats.commands);
+			SDL_SetWindowTitle(displayWindow, title);
+			statsElapsed = 0.0f;
+		}
 
 		SDL_GL_SwapWindow(displayWindow);
+		presented = true;
+		if (firstFrame) {
+			SDL_Log("startup: images decoded at %.1f ms, atlas uploaded at %.1f ms, shaders at %.1f ms, first frame at %.1f ms",
+				imagesDecoded, atlasUploaded, shadersLoaded, startupMilliseconds());
+			firstFrame = false;
+		}
+		drawnState = frameState;
 	}
 
+	levelPreloader.Cancel();
+	soundLoader.Wait();
 	Mix_HaltMusic();
 	Mix_FreeChunk(hit_wall);
 	Mix_FreeChunk(keySound);
@@ -1450,6 +687,12 @@ int main(int argc, char *argv[])
 	Mix_FreeChunk(swordSound);
 	Mix_FreeMusic(bgm);
 
+	mapMesh.Cleanup();
+	spriteBatch.Cleanup();
+	spriteInstancer.Cleanup();
+	textCache.Cleanup();
+	atlas.Cleanup();
+
 	SDL_Quit();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,24 @@
+attribute vec4 position;
+attribute vec2 texCoord;
+
+// x, y, width and height of the sprite, width is negative when it faces left
+attribute vec4 instanceTransform;
+// u, v, width and height of the first frame in the texture
+attribute vec4 instanceFrame;
+// frame count and phase, the frames follow each other to the right
+attribute vec2 instanceAnimation;
+
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+uniform float animationTime;
+uniform float framesPerSecond;
+
+varying vec2 texCoordVar;
+
+void main()
+{
+	vec4 p = vec4(instanceTransform.xy + position.xy * instanceTransform.zw, 0.0, 1.0);
+	float frame = mod(floor(animationTime * framesPerSecond + instanceAnimation.y), instanceAnimation.x);
+	texCoordVar = instanceFrame.xy + (texCoord + vec2(frame, 0.0)) * instanceFrame.zw;
+	gl_Position = projectionMatrix * viewMatrix * p;
+}